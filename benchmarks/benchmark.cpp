@@ -0,0 +1,310 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtTest/qtest.h>
+#include <QtGui/qpainter.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qscopeguard.h>
+#include "qtacryliceffecthelper.h"
+#include "qtacrylicsettings.h"
+#include "utilities.h"
+#include "testsupport.h"
+
+using namespace _qam;
+using namespace _qam::TestSupport;
+
+// The helper rows blur the synthetic wallpaper instead of the one of the desktop,
+// which isn't available on every platform and would make the results machine
+// dependent.
+static void useSyntheticWallpaper(const QSize &screenSize)
+{
+    QtAcrylicEffectHelper::setWallpaperOverride(syntheticWallpaper(QSize{2560, 1600}),
+                                                Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding, screenSize);
+}
+
+static QList<QPair<const char *, QSize>> screenSizes()
+{
+    return {
+        {"1080p", {1920, 1080}},
+        {"4K", {3840, 2160}},
+        {"8K", {7680, 4320}}
+    };
+}
+
+class QtAcrylicBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void blurImage_data();
+    void blurImage();
+    void blurImagePainter_data();
+    void blurImagePainter();
+    void halfScaled_data();
+    void halfScaled();
+    void blurImages_data();
+    void blurImages();
+    void variableBlurImage_data();
+    void variableBlurImage();
+    void updateAcrylicBrush();
+    void generateBluredWallpaper_data();
+    void generateBluredWallpaper();
+    void paintBackground_data();
+    void paintBackground();
+};
+
+void QtAcrylicBenchmark::cleanupTestCase()
+{
+    QtAcrylicEffectHelper::clearWallpaperOverride();
+}
+
+void QtAcrylicBenchmark::blurImage_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<qreal>("radius");
+    QTest::addColumn<int>("format");
+    const QList<QPair<const char *, QImage::Format>> formats = {
+        {"argb32pm", QImage::Format_ARGB32_Premultiplied},
+        {"rgb32", QImage::Format_RGB32},
+        {"gray8", QImage::Format_Grayscale8} // Alpha only kernel.
+    };
+    const QList<QPair<const char *, QSize>> sizes = screenSizes();
+    for (auto &&size : qAsConst(sizes)) {
+        for (auto &&format : qAsConst(formats)) {
+            for (auto &&radius : {4.0, 16.0, 64.0}) {
+                QTest::addRow("%s-%s-r%d", size.first, format.first, qRound(radius))
+                        << size.second << radius << static_cast<int>(format.second);
+            }
+        }
+    }
+}
+
+void QtAcrylicBenchmark::blurImage()
+{
+    QFETCH(QSize, size);
+    QFETCH(qreal, radius);
+    QFETCH(int, format);
+    // The kernel works in place and its cost doesn't depend on the content, so the
+    // same image is blurred again on every iteration.
+    QImage image = syntheticWallpaper(size, static_cast<QImage::Format>(format));
+    QBENCHMARK {
+        Utilities::blurImage(image, radius, false);
+    }
+}
+
+void QtAcrylicBenchmark::blurImagePainter_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<qreal>("radius");
+    QTest::addColumn<bool>("alphaOnly");
+    const QList<QPair<const char *, QSize>> sizes = screenSizes();
+    for (auto &&size : qAsConst(sizes)) {
+        for (auto &&alphaOnly : {false, true}) {
+            for (auto &&radius : {2.0, 16.0, 64.0}) {
+                QTest::addRow("%s-%s-r%d", size.first, (alphaOnly ? "alpha" : "rgba"), qRound(radius))
+                        << size.second << radius << alphaOnly;
+            }
+        }
+    }
+}
+
+void QtAcrylicBenchmark::blurImagePainter()
+{
+    QFETCH(QSize, size);
+    QFETCH(qreal, radius);
+    QFETCH(bool, alphaOnly);
+    const QImage source = syntheticWallpaper(size);
+    QImage target(size, QImage::Format_ARGB32_Premultiplied);
+    target.fill(Qt::transparent);
+    QPainter painter(&target);
+    QBENCHMARK {
+        // blurImage() replaces the image with a half scaled copy for large radii,
+        // start from the full size source every time.
+        QImage image = source;
+        painter.save();
+        Utilities::blurImage(&painter, image, radius, false, alphaOnly);
+        painter.restore();
+    }
+}
+
+void QtAcrylicBenchmark::halfScaled_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("format");
+    const QList<QPair<const char *, QImage::Format>> formats = {
+        {"argb32pm", QImage::Format_ARGB32_Premultiplied},
+        {"argb8565pm", QImage::Format_ARGB8565_Premultiplied},
+        {"gray8", QImage::Format_Grayscale8}
+    };
+    const QList<QPair<const char *, QSize>> sizes = screenSizes();
+    for (auto &&size : qAsConst(sizes)) {
+        for (auto &&format : qAsConst(formats)) {
+            QTest::addRow("%s-%s", size.first, format.first) << size.second << static_cast<int>(format.second);
+        }
+    }
+}
+
+void QtAcrylicBenchmark::halfScaled()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, format);
+    const QImage image = syntheticWallpaper(size, static_cast<QImage::Format>(format));
+    QBENCHMARK {
+        const QImage result = Utilities::halfScaledImage(image);
+        Q_UNUSED(result);
+    }
+}
+
+void QtAcrylicBenchmark::blurImages_data()
+{
+    QTest::addColumn<int>("threadCount");
+    QTest::addRow("thumbnails-1thread") << 1;
+    QTest::addRow("thumbnails-%dthreads", QThread::idealThreadCount()) << QThread::idealThreadCount();
+}
+
+void QtAcrylicBenchmark::blurImages()
+{
+    QFETCH(int, threadCount);
+    QVector<QImage> images = {};
+    for (int i = 0; i != 64; ++i) {
+        images.append(syntheticWallpaper({256, 256}));
+    }
+    // Kept across iterations, like a caller blurring batches in a loop would do.
+    Utilities::BlurWorkers workers;
+    QBENCHMARK {
+        Utilities::blurImages(images, 16, false, threadCount, &workers);
+    }
+}
+
+void QtAcrylicBenchmark::variableBlurImage_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<qreal>("radius");
+    const QList<QPair<const char *, QSize>> sizes = screenSizes();
+    for (auto &&size : qAsConst(sizes)) {
+        QTest::addRow("%s-r64", size.first) << size.second << 64.0;
+    }
+}
+
+void QtAcrylicBenchmark::variableBlurImage()
+{
+    QFETCH(QSize, size);
+    QFETCH(qreal, radius);
+    const QImage source = syntheticWallpaper(size);
+    // Strong at the top, sharp at the bottom, one radius per row.
+    QImage radiusMap(1, 256, QImage::Format_Grayscale8);
+    for (int y = 0; y != radiusMap.height(); ++y) {
+        *radiusMap.scanLine(y) = uchar(255 - y);
+    }
+    QBENCHMARK {
+        QImage image = source;
+        Utilities::variableBlurImage(image, radiusMap, radius);
+    }
+}
+
+void QtAcrylicBenchmark::updateAcrylicBrush()
+{
+    useSyntheticWallpaper(QSize{1920, 1080});
+    QtAcrylicEffectHelper helper;
+    helper.setTintColor(QColor(32, 32, 32));
+    helper.setTintOpacity(0.7);
+    // The first call sets up the shared noise texture.
+    helper.getAcrylicBrush();
+    QBENCHMARK {
+        // The rebuild is deferred until the brush is needed.
+        helper.updateAcrylicBrush();
+        helper.getAcrylicBrush();
+    }
+}
+
+void QtAcrylicBenchmark::generateBluredWallpaper_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<qreal>("radius");
+    const QList<QPair<const char *, QSize>> sizes = screenSizes();
+    for (auto &&size : qAsConst(sizes)) {
+        for (auto &&radius : {16.0, 64.0}) {
+            QTest::addRow("%s-r%d", size.first, qRound(radius)) << size.second << radius;
+        }
+    }
+}
+
+void QtAcrylicBenchmark::generateBluredWallpaper()
+{
+    QFETCH(QSize, size);
+    QFETCH(qreal, radius);
+    // "size" is the size of the screen, the wallpaper itself is generated at the
+    // default backdrop downsample factor, exactly like the surfaces do.
+    useSyntheticWallpaper(size);
+    const qreal oldRadius = QtAcrylicSettings::instance()->blurRadius();
+    QtAcrylicSettings::instance()->setBlurRadius(radius);
+    const auto restoreRadius = qScopeGuard([oldRadius](){
+        QtAcrylicSettings::instance()->setBlurRadius(oldRadius);
+    });
+    QtAcrylicEffectHelper helper;
+    // The first paint loads the settings and allocates the wallpaper, the following
+    // generations paint over it, so the allocation stays out of the numbers.
+    QImage target(QSize{1, 1}, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&target);
+    helper.paintBackground(&painter, QRect{0, 0, 1, 1}, {}, 1.0);
+    QBENCHMARK {
+        helper.regenerateWallpaper();
+    }
+}
+
+void QtAcrylicBenchmark::paintBackground_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("fluent");
+    QTest::addRow("800x600-default") << QSize{800, 600} << false;
+    QTest::addRow("800x600-fluent") << QSize{800, 600} << true;
+    QTest::addRow("1920x1080-default") << QSize{1920, 1080} << false;
+    QTest::addRow("1920x1080-fluent") << QSize{1920, 1080} << true;
+}
+
+void QtAcrylicBenchmark::paintBackground()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, fluent);
+    useSyntheticWallpaper(QSize{1920, 1080});
+    QtAcrylicEffectHelper helper;
+    helper.setTintColor(QColor(32, 32, 32));
+    helper.setTintOpacity(0.7);
+    helper.setMaterialMode(fluent ? QtAcrylicEffectHelper::MaterialMode::Fluent
+                                  : QtAcrylicEffectHelper::MaterialMode::Default);
+    QImage target(size, QImage::Format_ARGB32_Premultiplied);
+    target.fill(Qt::transparent);
+    QPainter painter(&target);
+    const QRect rect = {QPoint{0, 0}, size};
+    // Keep the one time wallpaper generation out of the steady state numbers.
+    helper.paintBackground(&painter, rect, {}, 1.0);
+    QBENCHMARK {
+        helper.paintBackground(&painter, rect, {}, 1.0);
+    }
+}
+
+QTEST_MAIN(QtAcrylicBenchmark)
+
+#include "benchmark.moc"
@@ -22,7 +22,6 @@
  * SOFTWARE.
  */
 
-#include "qtacrylicitem.h"
 #include <QtGui/qguiapplication.h>
 #include <QtQml/qqmlapplicationengine.h>
 #include <QtQuickControls2/qquickstyle.h>
@@ -65,8 +64,6 @@ int main(int argc, char *argv[])
     QQuickStyle::setStyle(QStringLiteral("Default"));
 #endif
 
-    qmlRegisterType<QtAcrylicItem>("wangwenx190.Utils", 1, 0, "AcrylicItem");
-
     const QUrl mainQmlUrl(QStringLiteral("qrc:///qml/main.qml"));
     const QMetaObject::Connection connection = QObject::connect(
         &engine,
@@ -0,0 +1,272 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtGui/qguiapplication.h>
+#include <QtGui/qpainter.h>
+#include <QtCore/qcommandlineparser.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qtextstream.h>
+#include <QtCore/qmap.h>
+#include "qtacryliceffecthelper.h"
+#include "qtacrylicconfig.h"
+#include "qtacrylicqualitygovernor.h"
+#include "qtacrylicsettings.h"
+#include "qtacrylictrace.h"
+#include "utilities.h"
+
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace _qam;
+
+// Renders an acrylic surface from a given wallpaper without a desktop session, through
+// the same code paths as the widgets, and prints how long each stage took.
+
+static QSize parseSize(const QString &value)
+{
+    const QStringList parts = value.split(QLatin1Char('x'));
+    if (parts.size() != 2) {
+        return {};
+    }
+    return {parts.at(0).toInt(), parts.at(1).toInt()};
+}
+
+static bool parseAspectStyle(const QString &value, Utilities::DesktopWallpaperAspectStyle *result)
+{
+    Q_ASSERT(result);
+    if (!result) {
+        return false;
+    }
+    static const QMap<QString, Utilities::DesktopWallpaperAspectStyle> styles = {
+        {QStringLiteral("central"), Utilities::DesktopWallpaperAspectStyle::Central},
+        {QStringLiteral("tiled"), Utilities::DesktopWallpaperAspectStyle::Tiled},
+        {QStringLiteral("stretch"), Utilities::DesktopWallpaperAspectStyle::IgnoreRatioFit},
+        {QStringLiteral("fit"), Utilities::DesktopWallpaperAspectStyle::KeepRatioFit},
+        {QStringLiteral("fill"), Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding},
+        {QStringLiteral("span"), Utilities::DesktopWallpaperAspectStyle::Span}
+    };
+    if (!styles.contains(value)) {
+        return false;
+    }
+    *result = styles.value(value);
+    return true;
+}
+
+// In bytes, 0 if unknown.
+static qint64 peakMemoryUsage()
+{
+#ifdef Q_OS_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    SecureZeroMemory(&counters, sizeof(counters));
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) {
+        return 0;
+    }
+    return qint64(counters.PeakWorkingSetSize);
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef Q_OS_MACOS
+    return qint64(usage.ru_maxrss);
+#else
+    return (qint64(usage.ru_maxrss) * 1024);
+#endif
+#endif
+}
+
+static QString toMiB(const qint64 bytes)
+{
+    return QString::number(qreal(bytes) / 1024.0 / 1024.0, 'f', 2);
+}
+
+int main(int argc, char *argv[])
+{
+    // No display is needed, don't require one unless the caller asks for a platform.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication application(argc, argv);
+    QGuiApplication::setApplicationName(QStringLiteral("AcrylicRender"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Renders an acrylic surface from a wallpaper image, without a desktop session."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("wallpaper"), QStringLiteral("The wallpaper image."));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("The PNG file to write."));
+    const QCommandLineOption screenSizeOption(QStringLiteral("screen-size"), QStringLiteral("Screen size in device independent pixels."), QStringLiteral("WxH"), QStringLiteral("1920x1080"));
+    const QCommandLineOption surfaceOption(QStringLiteral("surface"), QStringLiteral("Surface rectangle on the screen, the whole screen by default."), QStringLiteral("X,Y,WxH"));
+    const QCommandLineOption dprOption(QStringLiteral("dpr"), QStringLiteral("Device pixel ratio."), QStringLiteral("ratio"), QStringLiteral("1"));
+    const QCommandLineOption aspectStyleOption(QStringLiteral("aspect-style"), QStringLiteral("central, tiled, stretch, fit, fill or span."), QStringLiteral("style"), QStringLiteral("fill"));
+    const QCommandLineOption tintColorOption(QStringLiteral("tint-color"), QStringLiteral("Tint color."), QStringLiteral("color"), QStringLiteral("#ffffff"));
+    const QCommandLineOption tintOpacityOption(QStringLiteral("tint-opacity"), QStringLiteral("Tint opacity."), QStringLiteral("opacity"), QStringLiteral("0.7"));
+    const QCommandLineOption noiseOpacityOption(QStringLiteral("noise-opacity"), QStringLiteral("Noise opacity, 0 disables the noise."), QStringLiteral("opacity"), QStringLiteral("0.04"));
+    const QCommandLineOption luminosityOpacityOption(QStringLiteral("luminosity-opacity"), QStringLiteral("Luminosity opacity of the Fluent material."), QStringLiteral("opacity"), QStringLiteral("0.8"));
+    const QCommandLineOption fluentOption(QStringLiteral("fluent"), QStringLiteral("Use the Fluent material."));
+    const QCommandLineOption cornerRadiusOption(QStringLiteral("corner-radius"), QStringLiteral("Corner radius."), QStringLiteral("radius"), QStringLiteral("0"));
+    const QCommandLineOption blurRadiusOption(QStringLiteral("blur-radius"), QStringLiteral("Blur radius."), QStringLiteral("radius"), QString::number(QtAcrylicSettings::instance()->blurRadius()));
+    const QCommandLineOption downsampleOption(QStringLiteral("downsample"), QStringLiteral("Backdrop downsample factor."), QStringLiteral("factor"), QStringLiteral("1"));
+    const QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("How many times the surface is painted."), QStringLiteral("count"), QStringLiteral("1"));
+    const QCommandLineOption referenceOption(QStringLiteral("reference"), QStringLiteral("Compare the result with this image, fail if it differs."), QStringLiteral("image"));
+    const QCommandLineOption toleranceOption(QStringLiteral("tolerance"), QStringLiteral("Largest channel difference accepted by the comparison."), QStringLiteral("value"), QStringLiteral("0"));
+    parser.addOptions({screenSizeOption, surfaceOption, dprOption, aspectStyleOption, tintColorOption, tintOpacityOption,
+                       noiseOpacityOption, luminosityOpacityOption, fluentOption, cornerRadiusOption, blurRadiusOption,
+                       downsampleOption, iterationsOption, referenceOption, toleranceOption});
+    parser.process(application);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2) {
+        parser.showHelp(1);
+    }
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QImage wallpaper(arguments.at(0));
+    if (wallpaper.isNull()) {
+        err << "Failed to read the wallpaper " << arguments.at(0) << '\n';
+        return 1;
+    }
+    const QSize screenSize = parseSize(parser.value(screenSizeOption));
+    if (screenSize.isEmpty()) {
+        err << "Screen size not valid.\n";
+        return 1;
+    }
+    QRect surface = {QPoint{0, 0}, screenSize};
+    if (parser.isSet(surfaceOption)) {
+        const QStringList parts = parser.value(surfaceOption).split(QLatin1Char(','));
+        const QSize size = ((parts.size() == 3) ? parseSize(parts.at(2)) : QSize{});
+        if (size.isEmpty()) {
+            err << "Surface rectangle not valid.\n";
+            return 1;
+        }
+        surface = {QPoint{parts.at(0).toInt(), parts.at(1).toInt()}, size};
+    }
+    const qreal devicePixelRatio = parser.value(dprOption).toDouble();
+    if (devicePixelRatio <= 0) {
+        err << "Device pixel ratio not valid.\n";
+        return 1;
+    }
+    Utilities::DesktopWallpaperAspectStyle aspectStyle = {};
+    if (!parseAspectStyle(parser.value(aspectStyleOption), &aspectStyle)) {
+        err << "Aspect style not valid.\n";
+        return 1;
+    }
+    const QColor tintColor(parser.value(tintColorOption));
+    if (!tintColor.isValid()) {
+        err << "Tint color not valid.\n";
+        return 1;
+    }
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    QtAcrylicSettings *settings = QtAcrylicSettings::instance();
+    settings->setBlurRadius(parser.value(blurRadiusOption).toDouble());
+    settings->setBackdropDownsampleFactor(qMax(1, parser.value(downsampleOption).toInt()));
+    // Measure the full quality path, whatever it costs.
+    QtAcrylicQualityGovernor::instance()->setForcedTier(QtAcrylicQualityGovernor::Tier::Full);
+    QtAcrylicEffectHelper::setWallpaperOverride(wallpaper, aspectStyle, screenSize);
+
+    QtAcrylicEffectHelper helper;
+    // The OS blur can't be rendered into an image.
+    QtAcrylicConfig config = *QtAcrylicConfig::current();
+    config.disableExtraProcessing = false;
+    config.traditionalBlur = false;
+    helper.setConfigOverride(config);
+    helper.setTintColor(tintColor);
+    helper.setTintOpacity(parser.value(tintOpacityOption).toDouble());
+    helper.setNoiseOpacity(parser.value(noiseOpacityOption).toDouble());
+    helper.setLuminosityOpacity(parser.value(luminosityOpacityOption).toDouble());
+    helper.setMaterialMode(parser.isSet(fluentOption) ? QtAcrylicEffectHelper::MaterialMode::Fluent
+                                                      : QtAcrylicEffectHelper::MaterialMode::Default);
+    helper.setCornerRadius(qMax(0, parser.value(cornerRadiusOption).toInt()));
+    helper.updateAcrylicBrush();
+
+    QImage image(surface.size() * devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    QtAcrylicTrace::setEnabled(true);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i != iterations; ++i) {
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        helper.paintBackground(&painter, surface, {}, devicePixelRatio);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    QtAcrylicTrace::setEnabled(false);
+
+    if (!image.save(arguments.at(1), "PNG")) {
+        err << "Failed to write " << arguments.at(1) << '\n';
+        return 1;
+    }
+
+    // One line per stage: name, count, total and maximum in milliseconds.
+    struct StageTiming
+    {
+        int count = 0;
+        qint64 total = 0;
+        qint64 maximum = 0;
+    };
+    QMap<int, StageTiming> timings = {};
+    const auto records = QtAcrylicTrace::records();
+    for (auto &&record : qAsConst(records)) {
+        StageTiming &timing = timings[int(record.stage)];
+        ++timing.count;
+        timing.total += record.duration;
+        timing.maximum = qMax(timing.maximum, record.duration);
+    }
+    out << "stage\tcount\ttotal_ms\tmax_ms\n";
+    for (auto it = timings.cbegin(); it != timings.cend(); ++it) {
+        out << QtAcrylicTrace::stageName(QtAcrylicTrace::Stage(it.key())) << '\t' << it->count << '\t'
+            << QString::number(qreal(it->total) / 1000000.0, 'f', 3) << '\t'
+            << QString::number(qreal(it->maximum) / 1000000.0, 'f', 3) << '\n';
+    }
+    out << "total_ms\t" << QString::number(qreal(elapsed) / 1000000.0, 'f', 3) << '\n';
+    const QtAcrylicEffectHelper::MemoryUsage usage = QtAcrylicEffectHelper::memoryUsage();
+    out << "cache_mib\t" << toMiB(usage.total()) << '\n';
+    const qint64 peak = peakMemoryUsage();
+    out << "peak_memory_mib\t" << (peak > 0 ? toMiB(peak) : QStringLiteral("unknown")) << '\n';
+
+    if (parser.isSet(referenceOption)) {
+        const QImage reference(parser.value(referenceOption));
+        const Utilities::ImageDifference difference = Utilities::compareImages(image, reference, parser.value(toleranceOption).toInt());
+        if (!difference.comparable) {
+            err << "The reference image is missing or has a different size.\n";
+            return 1;
+        }
+        out << "max_error\t" << difference.maxError << '\n';
+        out << "mean_error\t" << difference.meanError << '\n';
+        out << "rmse\t" << difference.rootMeanSquareError << '\n';
+        out << "psnr_db\t" << difference.peakSignalToNoiseRatio << '\n';
+        out << "different_pixels\t" << difference.differentPixels << '\n';
+        if (difference.differentPixels > 0) {
+            return 2;
+        }
+    }
+
+    return 0;
+}
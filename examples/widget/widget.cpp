@@ -27,9 +27,6 @@
 #include <QtWidgets/qlabel.h>
 #include <QtCore/qdatetime.h>
 #include "qtacrylicwidget.h"
-#include "utilities.h"
-
-using namespace _qam;
 
 Widget::Widget(QWidget *parent) : QWidget(parent)
 {
@@ -50,14 +47,6 @@ void Widget::timerEvent(QTimerEvent *event)
     }
 }
 
-void Widget::moveEvent(QMoveEvent *event)
-{
-    QWidget::moveEvent(event);
-    if (m_acrylicWidget && Utilities::shouldUseWallpaperBlur()) {
-        m_acrylicWidget->update();
-    }
-}
-
 void Widget::setupUi()
 {
     m_acrylicWidget = new QtAcrylicWidget(this);
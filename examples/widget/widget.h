@@ -42,7 +42,6 @@ public:
 
 protected:
     void timerEvent(QTimerEvent *event) override;
-    void moveEvent(QMoveEvent *event) override;
 
 private:
     void setupUi();
@@ -0,0 +1,477 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "kernels.h"
+#include <QtCore/qmath.h>
+#include <cmath>
+#include <vector>
+
+using namespace _qam;
+
+/*
+ * Copied from https://code.qt.io/cgit/qt/qtbase.git/tree/src/widgets/effects/qpixmapfilter.cpp
+ * With minor modifications, most of them are format changes, and the QImage
+ * accesses replaced by plain buffers.
+ * They are exported functions of Qt, we can make use of them directly, but they are in the QtWidgets
+ * module, I don't want our library have such a dependency.
+ */
+
+#ifndef AVG
+#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
+#endif
+
+#ifndef AVG16
+#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
+#endif
+
+template<const int shift>
+static inline int qt_static_shift(const int value)
+{
+    if (shift == 0) {
+        return value;
+    } else if (shift > 0) {
+        return value << (uint(shift) & 0x1f);
+    } else {
+        return value >> (uint(-shift) & 0x1f);
+    }
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner(uchar *bptr, int &zR, int &zG, int &zB, int &zA, const int alpha)
+{
+    quint32 *pixel = reinterpret_cast<quint32 *>(bptr);
+#define Z_MASK (0xff << zprec)
+    const int A_zprec = qt_static_shift<zprec - 24>(*pixel) & Z_MASK;
+    const int R_zprec = qt_static_shift<zprec - 16>(*pixel) & Z_MASK;
+    const int G_zprec = qt_static_shift<zprec - 8>(*pixel)  & Z_MASK;
+    const int B_zprec = qt_static_shift<zprec>(*pixel)      & Z_MASK;
+#undef Z_MASK
+    const int zR_zprec = zR >> aprec;
+    const int zG_zprec = zG >> aprec;
+    const int zB_zprec = zB >> aprec;
+    const int zA_zprec = zA >> aprec;
+    zR += alpha * (R_zprec - zR_zprec);
+    zG += alpha * (G_zprec - zG_zprec);
+    zB += alpha * (B_zprec - zB_zprec);
+    zA += alpha * (A_zprec - zA_zprec);
+#define ZA_MASK (0xff << (zprec + aprec))
+    *pixel =
+        qt_static_shift<24 - zprec - aprec>(zA & ZA_MASK)
+        | qt_static_shift<16 - zprec - aprec>(zR & ZA_MASK)
+        | qt_static_shift<8 - zprec - aprec>(zG & ZA_MASK)
+        | qt_static_shift<-zprec - aprec>(zB & ZA_MASK);
+#undef ZA_MASK
+}
+
+// Offset of the alpha byte in a 32 bit pixel.
+static constexpr int alphaIndex = ((Q_BYTE_ORDER == Q_BIG_ENDIAN) ? 0 : 3);
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_alphaOnly(uchar *bptr, int &z, const int alpha)
+{
+    const int A_zprec = int(*(bptr)) << zprec;
+    const int z_zprec = z >> aprec;
+    z += alpha * (A_zprec - z_zprec);
+    *(bptr) = z >> (zprec + aprec);
+}
+
+// "bptr" points to the first channel to blur, "stride" is the pixel size.
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrow(uchar *bptr, const int width, const int stride, const int alpha)
+{
+    int zR = 0, zG = 0, zB = 0, zA = 0;
+    for (int index = 0; index < width; ++index) {
+        if (alphaOnly) {
+            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+        } else {
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
+        bptr += stride;
+    }
+    bptr -= stride;
+    for (int index = width - 2; index >= 0; --index) {
+        bptr -= stride;
+        if (alphaOnly) {
+            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+        } else {
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
+    }
+}
+
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrows(const Kernels::ImageView &image, const int alpha, const bool improvedQuality)
+{
+    const int pixelSize = Kernels::bytesPerPixel(image.format);
+    // The alpha only kernel works on one byte per pixel: the alpha byte of 32 bit
+    // pixels, or the only byte of 8 bit ones.
+    const int offset = ((alphaOnly && (pixelSize == 4)) ? alphaIndex : 0);
+    for (int row = 0; row < image.height; ++row) {
+        for (int i = 0; i <= int(improvedQuality); ++i) {
+            qt_blurrow<aprec, zprec, alphaOnly>(image.data + row * image.stride + offset, image.width, pixelSize, alpha);
+        }
+    }
+}
+
+// Same layout as qt_memrotate90() and qt_memrotate270() of QtGui, processed in
+// tiles so that both sides stay in the cache.
+static constexpr int kRotateTileSize = 32;
+
+template<typename T>
+static inline void qam_rotate90(const uchar *src, const int width, const int height, const qsizetype srcStride,
+                                uchar *dest, const qsizetype destStride)
+{
+    for (int tileY = 0; tileY < height; tileY += kRotateTileSize) {
+        const int stopY = qMin(tileY + kRotateTileSize, height);
+        for (int tileX = 0; tileX < width; tileX += kRotateTileSize) {
+            const int stopX = qMin(tileX + kRotateTileSize, width);
+            for (int y = tileY; y < stopY; ++y) {
+                const T *s = reinterpret_cast<const T *>(src + y * srcStride);
+                for (int x = tileX; x < stopX; ++x) {
+                    reinterpret_cast<T *>(dest + (width - 1 - x) * destStride)[y] = s[x];
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+static inline void qam_rotate270(const uchar *src, const int width, const int height, const qsizetype srcStride,
+                                 uchar *dest, const qsizetype destStride)
+{
+    for (int tileY = 0; tileY < height; tileY += kRotateTileSize) {
+        const int stopY = qMin(tileY + kRotateTileSize, height);
+        for (int tileX = 0; tileX < width; tileX += kRotateTileSize) {
+            const int stopX = qMin(tileX + kRotateTileSize, width);
+            for (int y = tileY; y < stopY; ++y) {
+                const T *s = reinterpret_cast<const T *>(src + y * srcStride);
+                for (int x = tileX; x < stopX; ++x) {
+                    reinterpret_cast<T *>(dest + x * destStride)[height - 1 - y] = s[x];
+                }
+            }
+        }
+    }
+}
+
+static inline void qam_rotate(const Kernels::ImageView &source, const Kernels::ImageView &destination, const bool clockwise)
+{
+    if (Kernels::bytesPerPixel(source.format) == 1) {
+        if (clockwise) {
+            qam_rotate270<quint8>(source.data, source.width, source.height, source.stride, destination.data, destination.stride);
+        } else {
+            qam_rotate90<quint8>(source.data, source.width, source.height, source.stride, destination.data, destination.stride);
+        }
+    } else {
+        if (clockwise) {
+            qam_rotate270<quint32>(source.data, source.width, source.height, source.stride, destination.data, destination.stride);
+        } else {
+            qam_rotate90<quint32>(source.data, source.width, source.height, source.stride, destination.data, destination.stride);
+        }
+    }
+}
+
+/*
+ *  expblur(QImage &img, const qreal radius)
+ *
+ *  Based on exponential blur algorithm by Jani Huhtanen
+ *
+ *  In-place blur of image 'img' with kernel
+ *  of approximate radius 'radius'.
+ *
+ *  Blurs with two sided exponential impulse
+ *  response.
+ *
+ *  aprec = precision of alpha parameter
+ *  in fixed-point format 0.aprec
+ *
+ *  zprec = precision of state parameters
+ *  zR,zG,zB and zA in fp format 8.zprec
+ */
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void expblur(const Kernels::ImageView &image, const Kernels::ImageView &transposed, const qreal radius,
+                           const bool improvedQuality, const int transposedOutput)
+{
+    qreal _radius = radius;
+    // halve the radius if we're using two passes
+    if (improvedQuality) {
+        _radius *= 0.5;
+    }
+    // choose the alpha such that pixels at radius distance from a fully
+    // saturated pixel will have an alpha component of no greater than
+    // the cutOffIntensity
+    const qreal cutOffIntensity = 2;
+    const int alpha = _radius <= qreal(1e-5)
+                    ? ((1 << aprec)-1)
+                    : qRound((1<<aprec)*(1 - qPow(cutOffIntensity * (1 / qreal(255)), 1 / _radius)));
+    qt_blurrows<aprec, zprec, alphaOnly>(image, alpha, improvedQuality);
+    // The columns are blurred as the rows of the transposed image.
+    qam_rotate(image, transposed, (transposedOutput >= 0));
+    qt_blurrows<aprec, zprec, alphaOnly>(transposed, alpha, improvedQuality);
+    if (transposedOutput == 0) {
+        qam_rotate(transposed, image, false);
+    }
+}
+
+int Kernels::bytesPerPixel(const PixelFormat format)
+{
+    switch (format) {
+    case PixelFormat::Gray8:
+        return 1;
+    case PixelFormat::ARGB8565Premultiplied:
+        return 3;
+    case PixelFormat::RGB32:
+    case PixelFormat::ARGB32Premultiplied:
+        return 4;
+    }
+    return 0;
+}
+
+Kernels::ConstImageView Kernels::toConstView(const ImageView &view)
+{
+    return {view.data, view.width, view.height, view.stride, view.format};
+}
+
+static inline bool isValidView(const Kernels::ConstImageView &view)
+{
+    return (view.data && (view.width > 0) && (view.height > 0)
+            && (view.stride >= (qsizetype(view.width) * Kernels::bytesPerPixel(view.format))));
+}
+
+bool Kernels::expBlur(const ImageView &image, const ImageView &transposed, const qreal radius,
+                      const bool improvedQuality, const bool alphaOnly, const int transposedOutput)
+{
+    Q_ASSERT(isValidView(toConstView(image)));
+    Q_ASSERT(isValidView(toConstView(transposed)));
+    if (!isValidView(toConstView(image)) || !isValidView(toConstView(transposed))) {
+        return false;
+    }
+    if ((image.format == PixelFormat::ARGB8565Premultiplied) || (transposed.format != image.format)
+            || (transposed.width != image.height) || (transposed.height != image.width)) {
+        return false;
+    }
+    if (alphaOnly || (image.format == PixelFormat::Gray8)) {
+        expblur<12, 10, true>(image, transposed, radius, improvedQuality, transposedOutput);
+    } else {
+        expblur<12, 10, false>(image, transposed, radius, improvedQuality, transposedOutput);
+    }
+    return true;
+}
+
+bool Kernels::halfScale(const ConstImageView &source, const ImageView &destination)
+{
+    Q_ASSERT(isValidView(source));
+    Q_ASSERT(isValidView(toConstView(destination)));
+    if (!isValidView(source) || !isValidView(toConstView(destination))) {
+        return false;
+    }
+    if ((destination.format != source.format) || (destination.width != (source.width / 2))
+            || (destination.height != (source.height / 2))) {
+        return false;
+    }
+    const qsizetype sx = source.stride;
+    const qsizetype sx2 = sx << 1;
+    const qsizetype dx = destination.stride;
+    const int ww = destination.width;
+    const int hh = destination.height;
+    if (source.format == PixelFormat::Gray8) {
+        // assumes grayscale
+        const uchar *src = source.data;
+        uchar *dst = destination.data;
+        for (int y = hh; y; --y, dst += dx, src += sx2) {
+            const uchar *p1 = src;
+            const uchar *p2 = src + sx;
+            uchar *q = dst;
+            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
+                *q = ((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2;
+            }
+        }
+    } else if (source.format == PixelFormat::ARGB8565Premultiplied) {
+        const uchar *src = source.data;
+        uchar *dst = destination.data;
+        for (int y = hh; y; --y, dst += dx, src += sx2) {
+            const uchar *p1 = src;
+            const uchar *p2 = src + sx;
+            uchar *q = dst;
+            for (int x = ww; x; --x, q += 3, p1 += 6, p2 += 6) {
+                // alpha
+                q[0] = AVG(AVG(p1[0], p1[3]), AVG(p2[0], p2[3]));
+                // rgb
+                const quint16 p16_1 = (p1[2] << 8) | p1[1];
+                const quint16 p16_2 = (p1[5] << 8) | p1[4];
+                const quint16 p16_3 = (p2[2] << 8) | p2[1];
+                const quint16 p16_4 = (p2[5] << 8) | p2[4];
+                const quint16 result = AVG16(AVG16(p16_1, p16_2), AVG16(p16_3, p16_4));
+                q[1] = result & 0xff;
+                q[2] = result >> 8;
+            }
+        }
+    } else {
+        const quint32 *src = reinterpret_cast<const quint32 *>(source.data);
+        quint32 *dst = reinterpret_cast<quint32 *>(destination.data);
+        const qsizetype sx32 = sx >> 2;
+        const qsizetype sx32_2 = sx32 << 1;
+        const qsizetype dx32 = dx >> 2;
+        for (int y = hh; y; --y, dst += dx32, src += sx32_2) {
+            const quint32 *p1 = src;
+            const quint32 *p2 = src + sx32;
+            quint32 *q = dst;
+            for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
+                *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
+            }
+        }
+    }
+    return true;
+}
+
+// Blends two premultiplied pixels, "a" + "b" == 256.
+static inline quint32 qam_interpolate(const quint32 x, const uint a, const quint32 y, const uint b)
+{
+    quint32 t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+    t >>= 8;
+    t &= 0xff00ff;
+    quint32 u = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+    u &= 0xff00ff00;
+    return (u | t);
+}
+
+// Where a coordinate of the full resolution image falls in a pyramid level.
+struct QtAcrylicLevelSample
+{
+    int first = 0;
+    int second = 0;
+    uint weight = 0; // Of the second sample, [0, 256].
+};
+
+static inline std::vector<QtAcrylicLevelSample> qam_levelSamples(const int size, const int levelSize, const int level)
+{
+    std::vector<QtAcrylicLevelSample> samples(size_t(size), QtAcrylicLevelSample{});
+    const qreal scale = qreal(1) / qreal(1 << level);
+    for (int i = 0; i != size; ++i) {
+        // Pixel centers, clamped to the edges.
+        const qreal position = qBound(qreal(0), ((i + qreal(0.5)) * scale) - qreal(0.5), qreal(levelSize - 1));
+        const int first = int(position);
+        QtAcrylicLevelSample &sample = samples[size_t(i)];
+        sample.first = first;
+        sample.second = qMin(first + 1, levelSize - 1);
+        sample.weight = uint(qRound((position - first) * 256));
+    }
+    return samples;
+}
+
+bool Kernels::variableBlur(const ImageView &image, const ConstImageView &radiusMap, const qreal maxRadius)
+{
+    Q_ASSERT(isValidView(toConstView(image)));
+    Q_ASSERT(isValidView(radiusMap));
+    if (!isValidView(toConstView(image)) || !isValidView(radiusMap)) {
+        return false;
+    }
+    if ((bytesPerPixel(image.format) != 4) || (radiusMap.format != PixelFormat::Gray8)
+            || (radiusMap.width != image.width) || (radiusMap.height != image.height)) {
+        return false;
+    }
+    if (maxRadius <= 0) {
+        return true;
+    }
+    // The smallest radius worth a level, in the pixels of that level.
+    const qreal levelRadius = 2;
+    int levelCount = qMax(1, int(std::floor(std::log2(maxRadius / levelRadius))));
+    while ((levelCount > 0) && (((image.width >> levelCount) < 1) || ((image.height >> levelCount) < 1))) {
+        --levelCount;
+    }
+    if (levelCount <= 0) {
+        return true;
+    }
+    // Level "k" is the image half scaled "k" times and blurred so that, back at
+    // full resolution, its radius is baseRadius * 2^k. Level 0 is the image itself.
+    const qreal baseRadius = maxRadius / qreal(1 << levelCount);
+    std::vector<std::vector<quint32>> pixels(size_t(levelCount + 1));
+    std::vector<ImageView> levels(size_t(levelCount + 1), ImageView{});
+    levels[0] = image;
+    for (int level = 1; level <= levelCount; ++level) {
+        const ImageView &previous = levels[size_t(level - 1)];
+        std::vector<quint32> &buffer = pixels[size_t(level)];
+        const int width = previous.width / 2;
+        const int height = previous.height / 2;
+        buffer.resize(size_t(width) * size_t(height));
+        levels[size_t(level)] = {reinterpret_cast<uchar *>(buffer.data()), width, height, qsizetype(width) * 4, image.format};
+        halfScale(toConstView(previous), levels[size_t(level)]);
+    }
+    // Blurred only once the whole pyramid exists, each level is scaled from the
+    // sharp one above it.
+    std::vector<quint32> transposed(size_t(levels[1].width) * size_t(levels[1].height));
+    for (int level = 1; level <= levelCount; ++level) {
+        const ImageView &view = levels[size_t(level)];
+        const ImageView transposedView = {reinterpret_cast<uchar *>(transposed.data()), view.height, view.width,
+                                          qsizetype(view.height) * 4, view.format};
+        expBlur(view, transposedView, baseRadius, false, false, 0);
+    }
+    // For each value of the map, the lower level and the weight of the upper one.
+    int lowerLevels[256] = {};
+    uint upperWeights[256] = {};
+    for (int value = 0; value != 256; ++value) {
+        const qreal radius = maxRadius * value / qreal(255);
+        int lower = 0;
+        qreal lowerRadius = 0;
+        qreal upperRadius = baseRadius * 2;
+        while ((lower < levelCount) && (radius >= upperRadius)) {
+            ++lower;
+            lowerRadius = upperRadius;
+            upperRadius *= 2;
+        }
+        lowerLevels[value] = lower;
+        upperWeights[value] = ((lower == levelCount) ? 0 : uint(qRound((radius - lowerRadius) / (upperRadius - lowerRadius) * 256)));
+    }
+    std::vector<std::vector<QtAcrylicLevelSample>> columns(size_t(levelCount + 1));
+    std::vector<std::vector<QtAcrylicLevelSample>> rows(size_t(levelCount + 1));
+    for (int level = 1; level <= levelCount; ++level) {
+        columns[size_t(level)] = qam_levelSamples(image.width, levels[size_t(level)].width, level);
+        rows[size_t(level)] = qam_levelSamples(image.height, levels[size_t(level)].height, level);
+    }
+    const auto sample = [&levels, &columns, &rows](const int level, const int x, const int y) -> quint32 {
+        const ImageView &view = levels[size_t(level)];
+        if (level == 0) {
+            return reinterpret_cast<const quint32 *>(view.data + y * view.stride)[x];
+        }
+        const QtAcrylicLevelSample &column = columns[size_t(level)][size_t(x)];
+        const QtAcrylicLevelSample &row = rows[size_t(level)][size_t(y)];
+        const quint32 *first = reinterpret_cast<const quint32 *>(view.data + row.first * view.stride);
+        const quint32 *second = reinterpret_cast<const quint32 *>(view.data + row.second * view.stride);
+        const quint32 top = qam_interpolate(first[column.first], 256 - column.weight, first[column.second], column.weight);
+        const quint32 bottom = qam_interpolate(second[column.first], 256 - column.weight, second[column.second], column.weight);
+        return qam_interpolate(top, 256 - row.weight, bottom, row.weight);
+    };
+    // Level 0 is only ever sampled at the pixel being written, so the result can
+    // go straight into the image.
+    for (int y = 0; y != image.height; ++y) {
+        const uchar *map = radiusMap.data + y * radiusMap.stride;
+        quint32 *line = reinterpret_cast<quint32 *>(image.data + y * image.stride);
+        for (int x = 0; x != image.width; ++x) {
+            const int lower = lowerLevels[map[x]];
+            const uint weight = upperWeights[map[x]];
+            const quint32 lowerPixel = sample(lower, x, y);
+            line[x] = ((weight == 0) ? lowerPixel : qam_interpolate(lowerPixel, 256 - weight, sample(lower + 1, x, y), weight));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+
+// The pixel kernels behind Utilities::blurImage() and Utilities::halfScaledImage(),
+// working on plain buffers so they can run on memory owned by the caller (shared
+// memory, mapped files, decoder output) without wrapping or copying it. Only
+// QtCore is needed, the QImage functions in utilities.h are thin wrappers.
+namespace _qam::Kernels {
+
+enum class PixelFormat
+{
+    Gray8, // Also alpha only masks and grayscale indexed images.
+    RGB32, // 0xffRRGGBB in native endianness, as QImage::Format_RGB32.
+    ARGB32Premultiplied, // 0xAARRGGBB in native endianness, as QImage::Format_ARGB32_Premultiplied.
+    ARGB8565Premultiplied // 24 bits, as QImage::Format_ARGB8565_Premultiplied. Half scaling only.
+};
+
+struct ImageView
+{
+    uchar *data = nullptr;
+    int width = 0;
+    int height = 0;
+    qsizetype stride = 0; // In bytes.
+    PixelFormat format = PixelFormat::ARGB32Premultiplied;
+};
+
+struct ConstImageView
+{
+    const uchar *data = nullptr;
+    int width = 0;
+    int height = 0;
+    qsizetype stride = 0; // In bytes.
+    PixelFormat format = PixelFormat::ARGB32Premultiplied;
+};
+
+QTACRYLICHELPER_API int bytesPerPixel(const PixelFormat format);
+QTACRYLICHELPER_API ConstImageView toConstView(const ImageView &view);
+
+// Exponential blur of "image", in place. The columns are blurred through
+// "transposed", which must be "image.height" wide and "image.width" high, in the
+// same format. With "transposedOutput" > 0 (< 0), the image is not rotated back:
+// the result is left in "transposed", rotated by 270 (90) degrees. With "alphaOnly",
+// only the alpha channel of 32 bit pixels is blurred. Returns false, without
+// touching anything, for unsupported formats or mismatching buffers.
+QTACRYLICHELPER_API bool expBlur(const ImageView &image, const ImageView &transposed, const qreal radius,
+                                 const bool improvedQuality, const bool alphaOnly, const int transposedOutput = 0);
+
+// Box filter downscale by two in each direction, "destination" must be half the
+// size of "source" (rounded down) and in the same format.
+QTACRYLICHELPER_API bool halfScale(const ConstImageView &source, const ImageView &destination);
+
+// Blurs every pixel of "image" (32 bit formats only) in place with its own radius:
+// the value of "radiusMap" (8 bit, same size) scaled from [0, 255] to [0, maxRadius].
+// The image is blurred once per level of a downsample pyramid, each level doubling
+// the radius, and every pixel interpolates between the two levels around its
+// radius, so the cost stays close to the one of a single fixed radius blur.
+QTACRYLICHELPER_API bool variableBlur(const ImageView &image, const ConstImageView &radiusMap, const qreal maxRadius);
+
+}
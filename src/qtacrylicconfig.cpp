@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "qtacrylicconfig.h"
+#include "utilities.h"
+#include <atomic>
+
+using namespace _qam;
+
+// Only accessed through the atomic shared_ptr functions.
+static std::shared_ptr<const QtAcrylicConfig> g_currentConfig = nullptr;
+
+QtAcrylicConfig QtAcrylicConfig::fromEnvironment()
+{
+    QtAcrylicConfig config = {};
+    config.disableExtraProcessing = qEnvironmentVariableIsSet(Global::_qam_disableExtraProcess);
+    config.forceEnableTraditionalBlur = qEnvironmentVariableIsSet(Global::_qam_forceEnableTraditionalBlur_flag);
+    config.forceDisableTraditionalBlur = qEnvironmentVariableIsSet(Global::_qam_forceDisableTraditionalBlur_flag);
+    config.forceEnableWallpaperBlur = qEnvironmentVariableIsSet(Global::_qam_forceEnableWallpaperBlur_flag);
+    config.forceDisableWallpaperBlur = qEnvironmentVariableIsSet(Global::_qam_forceDisableWallpaperBlur_flag);
+    config.forceEnableOfficialMSWin10AcrylicBlur = qEnvironmentVariableIsSet(Global::_qam_forceEnableOfficialMSWin10AcrylicBlur_flag);
+    config.forceDisableOfficialMSWin10AcrylicBlur = qEnvironmentVariableIsSet(Global::_qam_forceDisableOfficialMSWin10AcrylicBlur_flag);
+#ifdef Q_OS_WINDOWS
+    const bool userAllowed = !(config.forceDisableTraditionalBlur || config.forceEnableWallpaperBlur);
+    config.traditionalBlur = (userAllowed && Utilities::isTraditionalBlurSupported());
+#endif
+    return config;
+}
+
+std::shared_ptr<const QtAcrylicConfig> QtAcrylicConfig::current()
+{
+    std::shared_ptr<const QtAcrylicConfig> config = std::atomic_load(&g_currentConfig);
+    if (config) {
+        return config;
+    }
+    // Concurrent first calls may all read the environment, only one snapshot wins.
+    const auto created = std::make_shared<const QtAcrylicConfig>(fromEnvironment());
+    if (std::atomic_compare_exchange_strong(&g_currentConfig, &config, created)) {
+        return created;
+    }
+    return config;
+}
+
+void QtAcrylicConfig::setCurrent(const QtAcrylicConfig &value)
+{
+    std::atomic_store(&g_currentConfig, std::make_shared<const QtAcrylicConfig>(value));
+}
+
+void QtAcrylicConfig::reloadFromEnvironment()
+{
+    setCurrent(fromEnvironment());
+}
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <memory>
+
+// The configuration that used to be read from the environment on every call. A
+// snapshot is immutable: changing the configuration atomically swaps the current
+// snapshot, so readers (the render thread of Qt Quick included) never see a half
+// updated one, and the hot paths only read a few cached fields.
+struct QTACRYLICHELPER_API QtAcrylicConfig
+{
+    // As set in the environment, see qtacrylichelper_global.h for the names.
+    bool disableExtraProcessing = false;
+    bool forceEnableTraditionalBlur = false;
+    bool forceDisableTraditionalBlur = false;
+    bool forceEnableWallpaperBlur = false;
+    bool forceDisableWallpaperBlur = false;
+    bool forceEnableOfficialMSWin10AcrylicBlur = false;
+    bool forceDisableOfficialMSWin10AcrylicBlur = false;
+
+    // Resolved from the flags above and what the platform supports.
+    bool traditionalBlur = false;
+
+    static QtAcrylicConfig fromEnvironment();
+
+    // Created from the environment on first use.
+    static std::shared_ptr<const QtAcrylicConfig> current();
+    // Takes effect on the next paint.
+    static void setCurrent(const QtAcrylicConfig &value);
+    static void reloadFromEnvironment();
+};
@@ -24,25 +24,331 @@
 
 #include "qtacryliceffecthelper.h"
 #include "utilities.h"
+#include "qtacrylicqualitygovernor.h"
+#include "qtacrylicsettings.h"
+#include "qtacrylicconfig.h"
+#include "qtacrylictrace.h"
 #include <QtGui/qpainter.h>
 #include <QtCore/qdebug.h>
 #include <QtGui/qguiapplication.h>
 #include <QtGui/qscreen.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qcache.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qset.h>
+#include <QtCore/qscopeguard.h>
+#include <QtCore/qmath.h>
+#include <atomic>
+#include <limits>
 
 using namespace _qam;
 
+// Everything that affects the look of a precomposed backdrop.
+struct QtAcrylicComposedBackdropKey {
+    qint64 wallpaperKey = 0;
+    int materialMode = 0;
+    QRgb tintColor = 0; // The blended tint fill color in the default material mode.
+    int tintOpacity = 0; // In 1/1000, Fluent material mode only.
+    int luminosityOpacity = 0; // In 1/1000, Fluent material mode only.
+    int noiseOpacity = 0; // In 1/1000.
+    int noiseIntensity = 0; // In 1/1000.
+    int noiseTileSize = 0;
+};
+
+static inline bool operator==(const QtAcrylicComposedBackdropKey &lhs, const QtAcrylicComposedBackdropKey &rhs)
+{
+    return (lhs.wallpaperKey == rhs.wallpaperKey) && (lhs.materialMode == rhs.materialMode)
+            && (lhs.tintColor == rhs.tintColor) && (lhs.tintOpacity == rhs.tintOpacity)
+            && (lhs.luminosityOpacity == rhs.luminosityOpacity)
+            && (lhs.noiseOpacity == rhs.noiseOpacity) && (lhs.noiseIntensity == rhs.noiseIntensity)
+            && (lhs.noiseTileSize == rhs.noiseTileSize);
+}
+
+static inline uint qHash(const QtAcrylicComposedBackdropKey &key, const uint seed = 0)
+{
+    return ::qHash(key.wallpaperKey, seed) ^ ::qHash(key.tintColor, seed)
+            ^ ::qHash((key.tintOpacity << 16) ^ key.luminosityOpacity ^ (key.materialMode << 30), seed)
+            ^ ::qHash((key.noiseOpacity << 16) ^ key.noiseTileSize ^ (key.noiseIntensity << 20), seed);
+}
+
+static inline int toPermille(const qreal value)
+{
+    return qRound(qBound(qreal(0), value, qreal(1)) * qreal(1000));
+}
+
+// The cost of a precomposed backdrop is measured in KiB, so it fits into an int
+// even for very large screens. The limit follows QtAcrylicSettings::cacheMemoryBudget(),
+// minus what the other caches hold, see applyMemoryBudget().
+static constexpr int kMaxComposedBackdropCost = 64 * 1024;
+// In KiB as well.
+static constexpr int kMaxCornerMaskCost = 16 * 1024;
+static constexpr int kMaxNoiseTextureCost = 4 * 1024;
+
+// In milliseconds. A wallpaper is only evicted once no surface painted with it for
+// that long: two windows on screens of different scales must not take turns at
+// regenerating each other's wallpaper. The budget itself is checked at most once
+// per interval, unless a wallpaper has just been generated.
+static constexpr qint64 kWallpaperEvictionDelay = 5000;
+static constexpr qint64 kMemoryBudgetInterval = 1000;
+
+// The noise is a small repeated tile, larger ones don't look any different but
+// cost more to generate and to keep around.
+static constexpr int kMinNoiseTileSize = 8;
+static constexpr int kMaxNoiseTileSize = 512;
+
+// Bumped whenever an input shared by all the surfaces changes. Each cache records
+// the generations it was built from and is rebuilt on the next paint when they no
+// longer match, the other caches are left alone.
+static std::atomic_uint g_themeGeneration{1};
+static std::atomic_uint g_wallpaperGeneration{1};
+static std::atomic_uint g_screenGeneration{1};
+
+static inline int toDevicePixelRatioKey(const qreal devicePixelRatio)
+{
+    return qMax(1, qRound(devicePixelRatio * qreal(100)));
+}
+
+static inline QRect toPhysicalRect(const QRect &rect, const qreal devicePixelRatio)
+{
+    if (qFuzzyCompare(devicePixelRatio, qreal(1))) {
+        return rect;
+    }
+    const QPoint topLeft = {qRound(rect.x() * devicePixelRatio), qRound(rect.y() * devicePixelRatio)};
+    const QPoint bottomRight = {qRound((rect.x() + rect.width()) * devicePixelRatio), qRound((rect.y() + rect.height()) * devicePixelRatio)};
+    return {topLeft, QSize{bottomRight.x() - topLeft.x(), bottomRight.y() - topLeft.y()}};
+}
+
+// Everything derived from the desktop wallpaper, for one backdrop scale (the device
+// pixel ratio divided by the downsample factor, and halved again by the reduced
+// quality tiers). The pixmaps have the size of the screen in backdrop pixels and
+// are tagged with the scale, so without downsampling they can be blitted 1:1 on
+// high DPI screens.
+struct QtAcrylicWallpaperData {
+    QPixmap bluredWallpaper = {};
+    // Pixel access to the blured wallpaper for the Fluent material mode. This is
+    // a shallow copy of the pixmap data on raster platforms.
+    QImage bluredWallpaperImage = {};
+    // Whether the image above is that shallow copy, it doesn't use any memory of
+    // its own then.
+    bool bluredWallpaperImageShared = false;
+    // Whether the blured wallpaper covers the whole screen with opaque pixels. It
+    // is left transparent when the desktop wallpaper can't be read.
+    bool opaque = false;
+    qreal blurRadius = 0.0;
+    uint wallpaperGeneration = 0;
+    uint screenGeneration = 0;
+    // When the last paint that used this wallpaper happened, see currentTime().
+    qint64 lastUsed = 0;
+};
+
 // We only need one copy of the blured wallpaper and the noise texture for the whole application.
 // But making them become static variables is not allowed because QPixmap can't be constructed
 // before QGuiApplication, so we use "Q_GLOBAL_STATIC" instead, it will be initialized when we
 // first use it.
-
 struct QtAcrylicHelperData {
-    QPixmap bluredWallpaper = {};
-    QImage noiseTexture = {};
+    // Keyed by backdrop scale, in 1/100.
+    QHash<int, QtAcrylicWallpaperData> wallpapers = {};
+    bool watchingScreens = false;
+    // Keyed by tile size and intensity (in 1/1000). The textures are generated
+    // procedurally, so there is no image decoding (and no image plugin) involved
+    // on the startup path. The helpers keep a reference to the texture they use,
+    // evicting an entry never takes it away from them.
+    QCache<QPair<int, int>, QImage> noiseTextures{kMaxNoiseTextureCost};
+    // The blured wallpaper with the tint and the noise already blended in. The
+    // least recently used entries are dropped once the cost limit is reached,
+    // which keeps memory bounded when many distinct tints are in use.
+    QCache<QtAcrylicComposedBackdropKey, QPixmap> composedBackdrops{kMaxComposedBackdropCost};
+    // Anti-aliased circles used as coverage masks for the rounded corners, keyed by
+    // radius and device pixel ratio. They don't depend on the size of the surface,
+    // so a handful of entries is enough for a whole application.
+    QCache<QPair<int, int>, QImage> cornerMasks{kMaxCornerMaskCost};
+    // See kMemoryBudgetInterval.
+    qint64 nextBudgetCheck = 0;
+    // The textures uploaded by the surfaces themselves, see reportTextureMemory().
+    // Changed from the render thread of Qt Quick.
+    std::atomic<qint64> textureBytes{0};
+    // See QtAcrylicEffectHelper::setWallpaperOverride().
+    QImage wallpaperOverride = {};
+    Utilities::DesktopWallpaperAspectStyle wallpaperOverrideAspectStyle = Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding;
+    QSize screenSizeOverride = {};
 };
 
 Q_GLOBAL_STATIC(QtAcrylicHelperData, acrylicData)
 
+// In milliseconds, monotonic.
+static inline qint64 currentTime()
+{
+    static const QElapsedTimer clock = [](){
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.elapsed();
+}
+
+static inline void removeComposedBackdrops(const qint64 wallpaperKey)
+{
+    const auto keys = acrylicData()->composedBackdrops.keys();
+    for (auto &&key : qAsConst(keys)) {
+        if (key.wallpaperKey == wallpaperKey) {
+            acrylicData()->composedBackdrops.remove(key);
+        }
+    }
+}
+
+// The blured wallpaper covers the primary screen.
+static inline QSize primaryScreenSize()
+{
+    const QSize size = acrylicData()->screenSizeOverride;
+    if (size.isValid()) {
+        return size;
+    }
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    return (screen ? screen->size() : QSize{});
+}
+
+static inline qint64 pixmapBytes(const QPixmap &pixmap)
+{
+    return (qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8);
+}
+
+static inline qint64 imageBytes(const QImage &image)
+{
+    return (qint64(image.bytesPerLine()) * image.height());
+}
+
+// Whether every pixel of an ARGB32 (premultiplied or not) image is opaque.
+static inline bool isFullyOpaque(const QImage &image)
+{
+    if (!image.hasAlphaChannel()) {
+        return true;
+    }
+    for (int y = 0; y != image.height(); ++y) {
+        const auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x != image.width(); ++x) {
+            if (qAlpha(line[x]) != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static inline qint64 wallpaperBytes(const QtAcrylicWallpaperData &data)
+{
+    const qint64 bytes = pixmapBytes(data.bluredWallpaper);
+    return (data.bluredWallpaperImageShared ? bytes : (bytes + imageBytes(data.bluredWallpaperImage)));
+}
+
+// Keeps the shared caches within QtAcrylicSettings::cacheMemoryBudget(). The least
+// recently painted wallpapers (those of other screens) go first, but only those
+// unused for kWallpaperEvictionDelay: the budget may be exceeded for a while rather
+// than regenerating a wallpaper that is still in use. The precomposed backdrops get
+// whatever is left, QCache then drops its least recently used entries.
+static inline void applyMemoryBudget(const bool force = false)
+{
+    QtAcrylicHelperData *data = acrylicData();
+    const qint64 now = currentTime();
+    if (!force && (now < data->nextBudgetCheck)) {
+        return;
+    }
+    data->nextBudgetCheck = (now + kMemoryBudgetInterval);
+    const qint64 budget = qint64(QtAcrylicSettings::instance()->cacheMemoryBudget()) * 1024 * 1024;
+    qint64 used = (qint64(data->noiseTextures.totalCost()) + qint64(data->cornerMasks.totalCost())) * 1024;
+    used += data->textureBytes;
+    for (auto &&wallpaper : qAsConst(data->wallpapers)) {
+        used += wallpaperBytes(wallpaper);
+    }
+    while (used > budget) {
+        auto victim = data->wallpapers.end();
+        for (auto it = data->wallpapers.begin(); it != data->wallpapers.end(); ++it) {
+            if (((now - it->lastUsed) >= kWallpaperEvictionDelay)
+                    && ((victim == data->wallpapers.end()) || (it->lastUsed < victim->lastUsed))) {
+                victim = it;
+            }
+        }
+        if (victim == data->wallpapers.end()) {
+            break;
+        }
+        used -= wallpaperBytes(*victim);
+        removeComposedBackdrops(victim->bluredWallpaper.cacheKey());
+        data->wallpapers.erase(victim);
+    }
+    const int composedBudget = int(qBound(qint64(0), (budget - used) / 1024, qint64(std::numeric_limits<int>::max())));
+    if (data->composedBackdrops.maxCost() != composedBudget) {
+        // Shrinking the budget evicts the least recently used entries right away.
+        data->composedBackdrops.setMaxCost(composedBudget);
+    }
+}
+
+// Drops the wallpaper caches of the device pixel ratios that no screen uses anymore,
+// the caches of the other screens are left untouched.
+static inline void removeUnusedWallpapers()
+{
+    QSet<int> usedKeys = {};
+    const int downsampleFactor = QtAcrylicSettings::instance()->backdropDownsampleFactor();
+    const auto screens = QGuiApplication::screens();
+    for (auto &&screen : qAsConst(screens)) {
+        usedKeys.insert(toDevicePixelRatioKey(screen->devicePixelRatio() / downsampleFactor));
+    }
+    auto &wallpapers = acrylicData()->wallpapers;
+    for (auto it = wallpapers.begin(); it != wallpapers.end();) {
+        if (usedKeys.contains(it.key())) {
+            ++it;
+        } else {
+            removeComposedBackdrops(it->bluredWallpaper.cacheKey());
+            it = wallpapers.erase(it);
+        }
+    }
+}
+
+static inline void watchScreen(QScreen *screen)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return;
+    }
+    // There is no dedicated signal for device pixel ratio changes, but they always
+    // come together with a DPI change.
+    QObject::connect(screen, &QScreen::logicalDotsPerInchChanged, qApp, [](){
+        QtAcrylicEffectHelper::notifyScreensChanged();
+    });
+    QObject::connect(screen, &QScreen::physicalDotsPerInchChanged, qApp, [](){
+        QtAcrylicEffectHelper::notifyScreensChanged();
+    });
+    QObject::connect(screen, &QScreen::geometryChanged, qApp, [](){
+        QtAcrylicEffectHelper::notifyScreensChanged();
+    });
+}
+
+static inline void watchScreens()
+{
+    if (acrylicData()->watchingScreens || !qApp) {
+        return;
+    }
+    acrylicData()->watchingScreens = true;
+    const auto screens = QGuiApplication::screens();
+    for (auto &&screen : qAsConst(screens)) {
+        watchScreen(screen);
+    }
+    QObject::connect(qApp, &QGuiApplication::screenAdded, qApp, [](QScreen *screen){
+        watchScreen(screen);
+    });
+    QObject::connect(qApp, &QGuiApplication::screenRemoved, qApp, [](){
+        QtAcrylicEffectHelper::notifyScreensChanged();
+    });
+    QObject::connect(qApp, &QGuiApplication::primaryScreenChanged, qApp, [](){
+        QtAcrylicEffectHelper::notifyScreensChanged();
+    });
+    // The wallpapers of the previous downsample factor won't be used anymore.
+    QObject::connect(QtAcrylicSettings::instance(), &QtAcrylicSettings::backdropDownsampleFactorChanged, qApp, [](){
+        removeUnusedWallpapers();
+    });
+    QObject::connect(QtAcrylicSettings::instance(), &QtAcrylicSettings::cacheMemoryBudgetChanged, qApp, [](){
+        acrylicData()->nextBudgetCheck = 0;
+    });
+}
+
 QtAcrylicEffectHelper::QtAcrylicEffectHelper()
 {
     //QCoreApplication::setAttribute(Qt::AA_DontCreateNativeWidgetSiblings);
@@ -63,16 +369,72 @@ void QtAcrylicEffectHelper::showPerformanceWarning() const
                 "is running.";
 }
 
+QtAcrylicEffectHelper::MemoryUsage QtAcrylicEffectHelper::memoryUsage()
+{
+    MemoryUsage usage = {};
+    const QtAcrylicHelperData *data = acrylicData();
+    for (auto &&wallpaper : qAsConst(data->wallpapers)) {
+        usage.wallpapers += wallpaperBytes(wallpaper);
+    }
+    usage.composedBackdrops = qint64(data->composedBackdrops.totalCost()) * 1024;
+    usage.noiseTextures = qint64(data->noiseTextures.totalCost()) * 1024;
+    usage.cornerMasks = qint64(data->cornerMasks.totalCost()) * 1024;
+    usage.textures = data->textureBytes;
+    return usage;
+}
+
+void QtAcrylicEffectHelper::reportTextureMemory(const qint64 bytes)
+{
+    acrylicData()->textureBytes += bytes;
+}
+
 void QtAcrylicEffectHelper::regenerateWallpaper()
 {
-    if (!acrylicData()->bluredWallpaper.isNull()) {
-        acrylicData()->bluredWallpaper = {};
+    notifyWallpaperChanged();
+    ensureBluredWallpaper();
+}
+
+void QtAcrylicEffectHelper::notifyThemeChanged()
+{
+    ++g_themeGeneration;
+}
+
+void QtAcrylicEffectHelper::notifyWallpaperChanged()
+{
+    ++g_wallpaperGeneration;
+}
+
+void QtAcrylicEffectHelper::setWallpaperOverride(const QImage &wallpaper, const Utilities::DesktopWallpaperAspectStyle aspectStyle, const QSize &screenSize)
+{
+    Q_ASSERT(!wallpaper.isNull());
+    if (wallpaper.isNull()) {
+        return;
     }
-    generateBluredWallpaper();
+    acrylicData()->wallpaperOverride = wallpaper;
+    acrylicData()->wallpaperOverrideAspectStyle = aspectStyle;
+    acrylicData()->screenSizeOverride = screenSize;
+    notifyWallpaperChanged();
 }
 
-const QBrush &QtAcrylicEffectHelper::getAcrylicBrush() const
+void QtAcrylicEffectHelper::clearWallpaperOverride()
 {
+    acrylicData()->wallpaperOverride = {};
+    acrylicData()->screenSizeOverride = {};
+    notifyWallpaperChanged();
+}
+
+void QtAcrylicEffectHelper::notifyScreensChanged()
+{
+    ++g_screenGeneration;
+    // Nothing will ever use the wallpapers of a device pixel ratio that is gone.
+    if (qApp) {
+        removeUnusedWallpapers();
+    }
+}
+
+const QBrush &QtAcrylicEffectHelper::getAcrylicBrush()
+{
+    updateDirtyResources();
     return m_acrylicBrush;
 }
 
@@ -91,9 +453,100 @@ qreal QtAcrylicEffectHelper::getNoiseOpacity() const
     return m_noiseOpacity;
 }
 
+int QtAcrylicEffectHelper::getNoiseTileSize() const
+{
+    return m_noiseTileSize;
+}
+
+qreal QtAcrylicEffectHelper::getNoiseIntensity() const
+{
+    return m_noiseIntensity;
+}
+
+QtAcrylicEffectHelper::MaterialMode QtAcrylicEffectHelper::getMaterialMode() const
+{
+    return m_materialMode;
+}
+
+qreal QtAcrylicEffectHelper::getLuminosityOpacity() const
+{
+    return m_luminosityOpacity;
+}
+
+bool QtAcrylicEffectHelper::isBackdropCacheEnabled() const
+{
+    return m_backdropCacheEnabled;
+}
+
+int QtAcrylicEffectHelper::getCornerRadius() const
+{
+    return m_cornerRadius;
+}
+
+void QtAcrylicEffectHelper::setConfigOverride(const QtAcrylicConfig &value)
+{
+    m_configOverride = std::make_shared<const QtAcrylicConfig>(value);
+}
+
+void QtAcrylicEffectHelper::clearConfigOverride()
+{
+    m_configOverride.reset();
+}
+
+std::shared_ptr<const QtAcrylicConfig> QtAcrylicEffectHelper::getConfig() const
+{
+    return (m_configOverride ? m_configOverride : QtAcrylicConfig::current());
+}
+
+bool QtAcrylicEffectHelper::isWallpaperBlurActive() const
+{
+    return !getConfig()->traditionalBlur;
+}
+
+bool QtAcrylicEffectHelper::isOpaque() const
+{
+    return ((m_cornerRadius <= 0) && isBackdropOpaque());
+}
+
+QRegion QtAcrylicEffectHelper::getOpaqueRegion(const QSize &size) const
+{
+    if (size.isEmpty() || !isBackdropOpaque()) {
+        return {};
+    }
+    QRegion region = {QRect{QPoint{0, 0}, size}};
+    // Same corner squares as paintBackground(), only they may be partially covered.
+    const int radius = qMin(m_cornerRadius, qMin(size.width(), size.height()) / 2);
+    if (radius > 0) {
+        const QSize cornerSize = {radius, radius};
+        region -= QRect{QPoint{0, 0}, cornerSize};
+        region -= QRect{QPoint{size.width() - radius, 0}, cornerSize};
+        region -= QRect{QPoint{0, size.height() - radius}, cornerSize};
+        region -= QRect{QPoint{size.width() - radius, size.height() - radius}, cornerSize};
+    }
+    return region;
+}
+
+// The parts of the surface off the primary screen are filled with an opaque color
+// by compositeBackground(), so only the wallpaper itself decides.
+bool QtAcrylicEffectHelper::isBackdropOpaque() const
+{
+    const std::shared_ptr<const QtAcrylicConfig> config = getConfig();
+    if (config->disableExtraProcessing) {
+        return false;
+    }
+    if (QtAcrylicQualityGovernor::instance()->tier() == QtAcrylicQualityGovernor::Tier::SolidColor) {
+        return true;
+    }
+    // The OS blur needs the surface to be cleared, whatever is below it must show through.
+    if (config->traditionalBlur) {
+        return false;
+    }
+    return wallpaperData().opaque;
+}
+
 const QPixmap &QtAcrylicEffectHelper::getBluredWallpaper() const
 {
-    return acrylicData()->bluredWallpaper;
+    return wallpaperData().bluredWallpaper;
 }
 
 void QtAcrylicEffectHelper::setTintColor(const QColor &value)
@@ -104,6 +557,7 @@ void QtAcrylicEffectHelper::setTintColor(const QColor &value)
     }
     if (m_tintColor != value) {
         m_tintColor = value;
+        m_tintDirty = true;
     }
 }
 
@@ -111,119 +565,662 @@ void QtAcrylicEffectHelper::setTintOpacity(const qreal value)
 {
     if (m_tintOpacity != value) {
         m_tintOpacity = value;
+        m_tintDirty = true;
     }
 }
 
 void QtAcrylicEffectHelper::setNoiseOpacity(const qreal value)
 {
+    // Only the small acrylic brush tile depends on it, the noise texture and the
+    // precomposed backdrops apply it at composite time.
     if (m_noiseOpacity != value) {
         m_noiseOpacity = value;
+        m_acrylicBrushDirty = true;
     }
 }
 
-void QtAcrylicEffectHelper::paintBackground(QPainter *painter, const QRect &rect)
+void QtAcrylicEffectHelper::setNoiseTileSize(const int value)
+{
+    if (value <= 0) {
+        qWarning() << value << "is not a valid noise tile size.";
+        return;
+    }
+    const int tileSize = qBound(kMinNoiseTileSize, value, kMaxNoiseTileSize);
+    if (m_noiseTileSize != tileSize) {
+        m_noiseTileSize = tileSize;
+        m_brushDirty = true;
+    }
+}
+
+void QtAcrylicEffectHelper::setNoiseIntensity(const qreal value)
+{
+    if ((value < 0) || (value > 1)) {
+        qWarning() << value << "is not a valid noise intensity.";
+        return;
+    }
+    if (m_noiseIntensity != value) {
+        m_noiseIntensity = value;
+        m_brushDirty = true;
+    }
+}
+
+void QtAcrylicEffectHelper::setMaterialMode(const MaterialMode value)
+{
+    if (m_materialMode != value) {
+        m_materialMode = value;
+        m_tintDirty = true;
+    }
+}
+
+void QtAcrylicEffectHelper::setLuminosityOpacity(const qreal value)
+{
+    if (m_luminosityOpacity != value) {
+        m_luminosityOpacity = value;
+        m_tintDirty = true;
+    }
+}
+
+void QtAcrylicEffectHelper::setBackdropCacheEnabled(const bool value)
+{
+    if (m_backdropCacheEnabled != value) {
+        m_backdropCacheEnabled = value;
+        m_composedBackdropStableFrames = 0;
+    }
+}
+
+void QtAcrylicEffectHelper::setCornerRadius(const int value)
+{
+    if (value < 0) {
+        qWarning() << value << "is not a valid corner radius.";
+        return;
+    }
+    if (m_cornerRadius != value) {
+        m_cornerRadius = value;
+    }
+}
+
+void QtAcrylicEffectHelper::paintBackground(QPainter *painter, const QRect &rect, const QRegion &region, const qreal devicePixelRatio)
 {
     Q_ASSERT(painter);
     Q_ASSERT(rect.isValid());
     if (!painter || !rect.isValid()) {
         return;
     }
+    const std::shared_ptr<const QtAcrylicConfig> config = getConfig();
     // TODO: should we limit it to Win32 only? Or should we do something about the
     // acrylic brush instead?
-    if (Utilities::disableExtraProcessingForBlur()) {
+    if (config->disableExtraProcessing) {
         return;
     }
-    painter->save();
     const QRect maskRect = {QPoint{0, 0}, rect.size()};
-    if (Utilities::shouldUseTraditionalBlur()) {
+    const QRegion damage = (region.isEmpty() ? QRegion{maskRect} : region.intersected(maskRect));
+    if (damage.isEmpty()) {
+        return;
+    }
+    QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::PaintBackground, this, rect.size());
+    QtAcrylicQualityGovernor *governor = QtAcrylicQualityGovernor::instance();
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    qint64 wallpaperGenerationCost = 0;
+    updateDirtyResources();
+    loadSettings((devicePixelRatio > 0) ? devicePixelRatio : painter->device()->devicePixelRatioF());
+    const QtAcrylicQualityGovernor::Tier tier = m_tier;
+    const bool hasBackdrop = ((tier != QtAcrylicQualityGovernor::Tier::SolidColor) && !config->traditionalBlur);
+    if (hasBackdrop) {
+        wallpaperGenerationCost = ensureBluredWallpaper();
+    }
+    // The reduced tiers have their own, smaller, wallpaper, so they can use the
+    // precomposed backdrops as well.
+    const QPixmap *composedBackdrop = (hasBackdrop ? getComposedBackdrop(*config) : nullptr);
+    trace.setCacheHit(composedBackdrop != nullptr);
+    // The rounded corners are the only parts that need a coverage mask, the rest of
+    // the surface is composited directly, exactly like a rectangular one.
+    const int radius = qMin(m_cornerRadius, qMin(rect.width(), rect.height()) / 2);
+    QRegion opaqueDamage = damage;
+    QRect cornerRects[4] = {};
+    if (radius > 0) {
+        const QSize cornerSize = {radius, radius};
+        cornerRects[0] = {maskRect.topLeft(), cornerSize};
+        cornerRects[1] = {QPoint{maskRect.width() - radius, 0}, cornerSize};
+        cornerRects[2] = {QPoint{0, maskRect.height() - radius}, cornerSize};
+        cornerRects[3] = {QPoint{maskRect.width() - radius, maskRect.height() - radius}, cornerSize};
+        for (auto &&cornerRect : cornerRects) {
+            opaqueDamage -= cornerRect;
+        }
+    }
+    // Only composite what actually needs to be repainted, a small label updating
+    // inside a large surface should not repaint the whole backdrop. Regions made
+    // of many tiny rectangles are cheaper to handle as a whole.
+    if (opaqueDamage.rectCount() > 16) {
+        compositeBackground(painter, *config, rect, opaqueDamage.boundingRect(), tier, composedBackdrop);
+    } else {
+        for (auto &&damagedRect : opaqueDamage) {
+            compositeBackground(painter, *config, rect, damagedRect, tier, composedBackdrop);
+        }
+    }
+    if (radius > 0) {
+        for (int corner = 0; corner != 4; ++corner) {
+            if (damage.intersects(cornerRects[corner])) {
+                paintCorner(painter, *config, rect, cornerRects[corner], corner, tier, composedBackdrop);
+            }
+        }
+    }
+    // A new wallpaper is a one time cost, it should not make the governor think
+    // that every frame is slow.
+    governor->reportPaintCost(paintTimer.nsecsElapsed() - wallpaperGenerationCost);
+}
+
+bool QtAcrylicEffectHelper::canCompositeLayers() const
+{
+    const std::shared_ptr<const QtAcrylicConfig> config = getConfig();
+    return (!config->disableExtraProcessing && !config->traditionalBlur
+            && (m_materialMode == MaterialMode::Default) && (m_cornerRadius <= 0));
+}
+
+QtAcrylicEffectHelper::Layers QtAcrylicEffectHelper::getLayers(const qreal devicePixelRatio)
+{
+    Layers layers = {};
+    if (!canCompositeLayers()) {
+        return layers;
+    }
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    updateDirtyResources();
+    loadSettings((devicePixelRatio > 0) ? devicePixelRatio : m_devicePixelRatio);
+    if (m_tier == QtAcrylicQualityGovernor::Tier::SolidColor) {
+        layers.fillColor = m_solidFallbackColor;
+        QtAcrylicQualityGovernor::instance()->reportPaintCost(paintTimer.nsecsElapsed());
+        return layers;
+    }
+    const qint64 wallpaperGenerationCost = ensureBluredWallpaper();
+    // The reduced tiers already have a smaller backdrop scale.
+    layers.backdrop = wallpaperData().bluredWallpaper;
+    layers.backdropScale = m_backdropScale;
+    layers.opaqueBackdrop = wallpaperData().opaque;
+    if (layers.opaqueBackdrop) {
+        layers.baseColor = defaultMaskColor();
+    }
+    layers.fillColor = m_tintFillColor;
+    if (effectiveNoiseOpacity() > 0) {
+        layers.noiseTexture = m_noiseTexture;
+        layers.noiseOpacity = effectiveNoiseOpacity();
+    }
+    // Same as paintBackground(), the renderer reports the rest of the frame.
+    QtAcrylicQualityGovernor::instance()->reportPaintCost(paintTimer.nsecsElapsed() - wallpaperGenerationCost);
+    return layers;
+}
+
+void QtAcrylicEffectHelper::compositeBackground(QPainter *painter, const QtAcrylicConfig &config, const QRect &rect, const QRect &localRect,
+                                                const QtAcrylicQualityGovernor::Tier tier, const QPixmap *composedBackdrop)
+{
+    Q_ASSERT(painter);
+    if (!painter || localRect.isEmpty()) {
+        return;
+    }
+    // From here on, the painter origin is the top left corner of the damaged
+    // rectangle and "globalRect" is the part of the screen it covers.
+    const QRect globalRect = localRect.translated(rect.topLeft());
+    const QRect targetRect = {QPoint{0, 0}, localRect.size()};
+    painter->save();
+    painter->translate(localRect.topLeft());
+    if (tier == QtAcrylicQualityGovernor::Tier::SolidColor) {
+        painter->fillRect(targetRect, m_solidFallbackColor);
+        painter->restore();
+        return;
+    }
+    bool tintApplied = false;
+    bool noiseApplied = false;
+    if (config.traditionalBlur) {
         const QPainter::CompositionMode mode = painter->compositionMode();
         painter->setCompositionMode(QPainter::CompositionMode_Clear);
-        painter->fillRect(maskRect, defaultMaskColor());
+        painter->fillRect(targetRect, defaultMaskColor());
         painter->setCompositionMode(mode);
     } else {
-        // Emulate blur behind window by blurring the desktop wallpaper.
-        if (acrylicData()->bluredWallpaper.isNull()) {
-            generateBluredWallpaper();
+        // Emulate blur behind window by blurring the desktop wallpaper. It only
+        // covers the primary screen.
+        const QRect coveredRect = globalRect.intersected({QPoint{0, 0}, primaryScreenSize()});
+        const QRectF coveredTargetRect = coveredRect.translated(-globalRect.topLeft());
+        // The backdrops are in physical pixels, the source rectangles must be too.
+        const QRect physicalRect = toPhysicalRect(coveredRect, m_backdropScale);
+        if (composedBackdrop) {
+            // Everything is already blended in, a single blit is enough.
+            if (!coveredRect.isEmpty()) {
+                painter->drawPixmap(coveredTargetRect, *composedBackdrop, QRectF(physicalRect));
+            }
+            tintApplied = true;
+            noiseApplied = true;
+        } else if (isFluentBlendActive(config)) {
+            paintFluentBackdrop(painter, globalRect);
+            tintApplied = true;
+        } else if (!coveredRect.isEmpty()) {
+            painter->drawPixmap(coveredTargetRect, wallpaperData().bluredWallpaper, QRectF(physicalRect));
+        }
+        if ((coveredRect != globalRect) && wallpaperData().opaque) {
+            // Off the primary screen there is nothing to blur. Keep the surface as
+            // opaque as isOpaque() claims with the base of the solid color tier,
+            // the tint (if not applied yet) goes over it as everywhere else.
+            const QRegion uncovered = QRegion{targetRect} - coveredTargetRect.toRect();
+            const QColor &baseColor = (tintApplied ? m_solidFallbackColor : defaultMaskColor());
+            for (auto &&uncoveredRect : uncovered) {
+                painter->fillRect(uncoveredRect, baseColor);
+            }
         }
-        painter->drawPixmap(QPoint{0, 0}, acrylicData()->bluredWallpaper, rect);
     }
     painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
     painter->setOpacity(1);
-    painter->fillRect(maskRect, m_acrylicBrush);
+    const bool noise = (!noiseApplied && (effectiveNoiseOpacity() > 0));
+    // Anchor the noise to the screen, the same way the precomposed backdrop does,
+    // so switching between the two paths is seamless.
+    painter->setBrushOrigin(-globalRect.topLeft());
+    if (!tintApplied && noise) {
+        // The tint and the noise are baked into one tile, a single blend.
+        painter->fillRect(targetRect, m_acrylicBrush);
+    } else if (!tintApplied) {
+        painter->fillRect(targetRect, m_tintFillColor);
+    } else if (noise) {
+        painter->setOpacity(effectiveNoiseOpacity());
+        painter->fillRect(targetRect, m_noiseBrush);
+    }
     painter->restore();
 }
 
-void QtAcrylicEffectHelper::updateAcrylicBrush(const QColor &alternativeTintColor)
+const QPixmap *QtAcrylicEffectHelper::getComposedBackdrop(const QtAcrylicConfig &config)
 {
-    if (acrylicData()->noiseTexture.isNull()) {
-        Q_INIT_RESOURCE(qtacrylichelper);
-        acrylicData()->noiseTexture = QImage{QStringLiteral(":/QtAcrylicHelper/Noise.png")};
+    if (!m_backdropCacheEnabled) {
+        return nullptr;
     }
-    QImage acrylicTexture({64, 64}, QImage::Format_ARGB32_Premultiplied);
-    QColor fillColor = Qt::transparent;
-#ifdef Q_OS_WINDOWS
-    if (!Utilities::isOfficialMSWin10AcrylicBlurAvailable()) {
-        // Add a soft light layer for the background.
-        fillColor = defaultMaskColor();
-        fillColor.setAlpha(150);
+    const QPixmap &wallpaper = wallpaperData().bluredWallpaper;
+    if (wallpaper.isNull()) {
+        return nullptr;
     }
-#endif
-    acrylicTexture.fill(fillColor);
-    QPainter painter(&acrylicTexture);
-    painter.setOpacity(m_tintOpacity);
-    painter.fillRect(QRect{0, 0, acrylicTexture.width(), acrylicTexture.height()}, getAppropriateTintColor(alternativeTintColor));
-    painter.setOpacity(m_noiseOpacity);
-    painter.fillRect(QRect{0, 0, acrylicTexture.width(), acrylicTexture.height()}, acrylicData()->noiseTexture);
-    m_acrylicBrush = acrylicTexture;
+    const bool fluent = isFluentBlendActive(config);
+    QtAcrylicComposedBackdropKey key = {};
+    key.wallpaperKey = wallpaper.cacheKey();
+    key.materialMode = int(fluent ? MaterialMode::Fluent : MaterialMode::Default);
+    if (fluent) {
+        key.tintColor = getAppropriateTintColor(m_alternativeTintColor).rgba();
+        key.tintOpacity = toPermille(m_tintOpacity);
+        key.luminosityOpacity = toPermille(m_luminosityOpacity);
+    } else {
+        key.tintColor = m_tintFillColor.rgba();
+    }
+    key.noiseOpacity = toPermille(effectiveNoiseOpacity());
+    key.noiseIntensity = toPermille(m_noiseIntensity);
+    key.noiseTileSize = m_noiseTileSize;
+    QPixmap *cached = acrylicData()->composedBackdrops.object(key);
+    if (cached) {
+        return cached;
+    }
+    // Don't compose anything while the parameters are still changing (during an
+    // animation for example), every frame would produce a full screen pixmap that
+    // is thrown away right after. Wait until the same parameters are painted twice.
+    const uint keyHash = qHash(key);
+    if (keyHash != m_composedBackdropKey) {
+        m_composedBackdropKey = keyHash;
+        m_composedBackdropStableFrames = 0;
+        return nullptr;
+    }
+    if (++m_composedBackdropStableFrames < 2) {
+        return nullptr;
+    }
+    // Composed in physical pixels, the device pixel ratio is only set afterwards.
+    auto composed = new QPixmap(wallpaper.size());
+    composed->fill(Qt::transparent);
+    {
+        const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::ComposeBackdrop, this, wallpaper.size());
+        const QRect composedRect = {QPoint{0, 0}, wallpaper.size()};
+        QPixmap source = wallpaper;
+        source.setDevicePixelRatio(1);
+        QPainter painter(composed);
+        if (fluent) {
+            const QImage &wallpaperImage = getBluredWallpaperImage();
+            QImage blended(wallpaperImage.size(), QImage::Format_ARGB32_Premultiplied);
+            Utilities::fluentBlend(wallpaperImage, wallpaperImage.rect(), blended, m_fluentBlendTables);
+            painter.drawImage(QPoint{0, 0}, blended);
+        } else {
+            painter.drawPixmap(QPoint{0, 0}, source);
+            painter.fillRect(composedRect, m_tintFillColor);
+        }
+        if (effectiveNoiseOpacity() > 0) {
+            // Keep the noise grain at the same size as in the live path.
+            painter.scale(m_backdropScale, m_backdropScale);
+            painter.setOpacity(effectiveNoiseOpacity());
+            painter.fillRect(QRectF{QPointF{0, 0}, QSizeF(composedRect.size()) / m_backdropScale}, m_noiseBrush);
+        }
+    }
+    composed->setDevicePixelRatio(wallpaper.devicePixelRatio());
+    const int cost = qMax(1, int((qint64(composed->width()) * composed->height() * composed->depth() / 8) / 1024));
+    if (!acrylicData()->composedBackdrops.insert(key, composed, cost)) {
+        // Too large for the cache, it has already been deleted by QCache.
+        return nullptr;
+    }
+    return acrylicData()->composedBackdrops.object(key);
 }
 
-void QtAcrylicEffectHelper::generateBluredWallpaper()
+void QtAcrylicEffectHelper::paintCorner(QPainter *painter, const QtAcrylicConfig &config, const QRect &rect, const QRect &cornerRect,
+                                        const int corner, const QtAcrylicQualityGovernor::Tier tier, const QPixmap *composedBackdrop)
 {
-    if (!acrylicData()->bluredWallpaper.isNull()) {
+    Q_ASSERT(painter);
+    if (!painter || cornerRect.isEmpty()) {
         return;
     }
-    const QSize size = QGuiApplication::primaryScreen()->size();
-    acrylicData()->bluredWallpaper = QPixmap(size);
-    acrylicData()->bluredWallpaper.fill(Qt::transparent);
-    QImage image = Utilities::getDesktopWallpaperImage();
-    // On some platforms we may not be able to get the desktop wallpaper, such as Linux and WebAssembly.
-    if (image.isNull()) {
+    const int radius = cornerRect.width();
+    const QImage &mask = getCornerMask(radius);
+    if (mask.isNull()) {
         return;
     }
-    const Utilities::DesktopWallpaperAspectStyle aspectStyle = Utilities::getDesktopWallpaperAspectStyle();
-    QImage buffer(size, QImage::Format_ARGB32_Premultiplied);
-#ifdef Q_OS_WINDOWS
-    if ((aspectStyle == Utilities::DesktopWallpaperAspectStyle::Central) ||
-            (aspectStyle == Utilities::DesktopWallpaperAspectStyle::KeepRatioFit)) {
-        buffer.fill(Utilities::getDesktopBackgroundColor());
+    // Composite the corner off screen, cut it with the coverage mask and blend the
+    // result over whatever is below the surface. This is a couple of small blits,
+    // unlike a clip path, which makes the raster engine rasterize the path again
+    // on every paint.
+    const QSize scratchSize = mask.size() / 2;
+    if (m_cornerScratchImage.size() != scratchSize) {
+        m_cornerScratchImage = QImage(scratchSize, QImage::Format_ARGB32_Premultiplied);
+    }
+    m_cornerScratchImage.setDevicePixelRatio(m_devicePixelRatio);
+    m_cornerScratchImage.fill(Qt::transparent);
+    // Each corner is one quadrant of the circle. The quadrant is picked in device
+    // pixels and stretched over the corner, at fractional device pixel ratios the
+    // physical radius is rounded up and doesn't match the logical one.
+    const int physicalRadius = (mask.width() / 2);
+    const QRectF quadrant = {qreal((corner % 2) ? physicalRadius : 0), qreal((corner / 2) ? physicalRadius : 0),
+                             qreal(physicalRadius), qreal(physicalRadius)};
+    {
+        QPainter scratchPainter(&m_cornerScratchImage);
+        scratchPainter.translate(-cornerRect.topLeft());
+        compositeBackground(&scratchPainter, config, rect, cornerRect, tier, composedBackdrop);
+        scratchPainter.resetTransform();
+        scratchPainter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+        scratchPainter.drawImage(QRectF{QPointF{0, 0}, QSizeF(radius, radius)}, mask, quadrant);
+    }
+    if ((tier != QtAcrylicQualityGovernor::Tier::SolidColor) && config.traditionalBlur) {
+        // Like the rest of the surface, the corner replaces what is below it for
+        // the OS blur to show through, instead of being blended over it: cut the
+        // coverage out of the destination, then add the masked corner.
+        painter->save();
+        painter->setCompositionMode(QPainter::CompositionMode_DestinationOut);
+        painter->drawImage(QRectF(cornerRect), mask, quadrant);
+        painter->setCompositionMode(QPainter::CompositionMode_Plus);
+        painter->drawImage(cornerRect.topLeft(), m_cornerScratchImage);
+        painter->restore();
+    } else {
+        painter->drawImage(cornerRect.topLeft(), m_cornerScratchImage);
+    }
+}
+
+const QImage &QtAcrylicEffectHelper::getCornerMask(const int radius) const
+{
+    const QPair<int, int> key = {radius, toDevicePixelRatioKey(m_devicePixelRatio)};
+    QImage *mask = acrylicData()->cornerMasks.object(key);
+    if (!mask) {
+        // An even physical size, so that the quadrants are exactly the same size.
+        const int physicalRadius = qCeil(radius * m_devicePixelRatio);
+        mask = new QImage(QSize{physicalRadius, physicalRadius} * 2, QImage::Format_ARGB32_Premultiplied);
+        mask->fill(Qt::transparent);
+        {
+            QPainter painter(mask);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(Qt::white);
+            painter.drawEllipse(QRectF{QPointF{0, 0}, QSizeF(mask->size())});
+        }
+        mask->setDevicePixelRatio(m_devicePixelRatio);
+        // A mask larger than the whole cache would be deleted right away by QCache,
+        // such radii are unrealistic, so the cost is clamped instead.
+        const int cost = qMax(1, int(imageBytes(*mask) / 1024));
+        acrylicData()->cornerMasks.insert(key, mask, qMin(cost, kMaxCornerMaskCost));
+    }
+    return *mask;
+}
+
+bool QtAcrylicEffectHelper::isFluentBlendActive(const QtAcrylicConfig &config) const
+{
+    // The Fluent recipe needs the pixels behind the surface, which we only have
+    // in wallpaper blur mode. The OS blur falls back to the default recipe, and so
+    // does a wallpaper that couldn't be read: blending the tint into transparent
+    // pixels would leave the surface without any tint at all.
+    return ((m_materialMode == MaterialMode::Fluent) && !config.traditionalBlur && wallpaperData().opaque);
+}
+
+QtAcrylicWallpaperData &QtAcrylicEffectHelper::wallpaperData() const
+{
+    return acrylicData()->wallpapers[toDevicePixelRatioKey(m_backdropScale)];
+}
+
+void QtAcrylicEffectHelper::loadSettings(const qreal devicePixelRatio)
+{
+    // Read once per paint, the settings can be changed from another thread.
+    const QtAcrylicSettings *settings = QtAcrylicSettings::instance();
+    m_tier = QtAcrylicQualityGovernor::instance()->tier();
+    m_devicePixelRatio = devicePixelRatio;
+    m_backdropScale = (devicePixelRatio / settings->backdropDownsampleFactor());
+    if ((m_tier == QtAcrylicQualityGovernor::Tier::ReducedResolution) || (m_tier == QtAcrylicQualityGovernor::Tier::NoNoise)) {
+        // The wallpaper is generated (and blured) at half the resolution, not
+        // scaled down from the full one, which is never generated at all.
+        m_backdropScale /= 2.0;
+    }
+    m_blurRadius = settings->blurRadius();
+    m_noiseEnabled = settings->isNoiseEnabled();
+}
+
+qreal QtAcrylicEffectHelper::effectiveNoiseOpacity() const
+{
+    // The noise is the first thing the quality governor gives up.
+    const bool noiseTier = ((m_tier == QtAcrylicQualityGovernor::Tier::Full) || (m_tier == QtAcrylicQualityGovernor::Tier::ReducedResolution));
+    return ((m_noiseEnabled && noiseTier) ? m_noiseOpacity : qreal(0));
+}
+
+qint64 QtAcrylicEffectHelper::ensureBluredWallpaper()
+{
+    QtAcrylicWallpaperData &data = wallpaperData();
+    QPixmap recycled = {};
+    if (!data.bluredWallpaper.isNull()) {
+        bool outdated = (!qFuzzyCompare(data.blurRadius, m_blurRadius) || (data.wallpaperGeneration != g_wallpaperGeneration));
+        const uint screenGeneration = g_screenGeneration;
+        if (!outdated && (data.screenGeneration != screenGeneration)) {
+            // Of the whole screen layout, the wallpaper only depends on the size of
+            // the primary screen.
+            outdated = (data.bluredWallpaper.size() != (primaryScreenSize() * m_backdropScale));
+            data.screenGeneration = screenGeneration;
+        }
+        if (outdated) {
+            // Only the wallpaper of this scale and what was composed from it are
+            // outdated, the other caches are still valid.
+            removeComposedBackdrops(data.bluredWallpaper.cacheKey());
+            recycled = std::move(data.bluredWallpaper);
+            data = {};
+        }
+    }
+    data.lastUsed = currentTime();
+    if (!data.bluredWallpaper.isNull()) {
+        applyMemoryBudget();
+        return 0;
+    }
+    QElapsedTimer generationTimer;
+    generationTimer.start();
+    generateBluredWallpaper(std::move(recycled));
+    const qint64 cost = generationTimer.nsecsElapsed();
+    QtAcrylicQualityGovernor::instance()->reportWallpaperGenerationCost(cost);
+    applyMemoryBudget(true);
+    return cost;
+}
+
+const QImage &QtAcrylicEffectHelper::getBluredWallpaperImage() const
+{
+    QtAcrylicWallpaperData &data = wallpaperData();
+    if (data.bluredWallpaperImage.isNull()) {
+        data.bluredWallpaperImage = data.bluredWallpaper.toImage();
+        // A real conversion gives a new buffer each time.
+        data.bluredWallpaperImageShared = (data.bluredWallpaperImage.constBits() == data.bluredWallpaper.toImage().constBits());
+    }
+    return data.bluredWallpaperImage;
+}
+
+void QtAcrylicEffectHelper::paintFluentBackdrop(QPainter *painter, const QRect &rect)
+{
+    Q_ASSERT(painter);
+    if (!painter) {
+        return;
+    }
+    const QImage &wallpaperImage = getBluredWallpaperImage();
+    const QRect physicalRect = toPhysicalRect(rect, m_backdropScale);
+    const QRect sourceRect = physicalRect.intersected(wallpaperImage.rect());
+    if (sourceRect.isEmpty()) {
+        return;
+    }
+    // Reuse the scratch image across paints, it only grows.
+    if ((m_fluentScratchImage.width() < sourceRect.width()) || (m_fluentScratchImage.height() < sourceRect.height())) {
+        const QSize scratchSize = sourceRect.size().expandedTo(m_fluentScratchImage.size());
+        m_fluentScratchImage = QImage(scratchSize, QImage::Format_ARGB32_Premultiplied);
+    }
+    Utilities::fluentBlend(wallpaperImage, sourceRect, m_fluentScratchImage, m_fluentBlendTables);
+    const QPointF targetPos = QPointF(sourceRect.topLeft() - physicalRect.topLeft()) / m_backdropScale;
+    const QSizeF targetSize = QSizeF(sourceRect.size()) / m_backdropScale;
+    painter->drawImage(QRectF{targetPos, targetSize}, m_fluentScratchImage, QRectF{QPointF{0, 0}, QSizeF(sourceRect.size())});
+}
+
+void QtAcrylicEffectHelper::updateAcrylicBrush(const QColor &alternativeTintColor)
+{
+    // Only record the request here, the actual work is deferred to the next paint,
+    // so setting several properties in a row (or animating them) costs at most
+    // one rebuild per frame.
+    m_alternativeTintColor = alternativeTintColor;
+    m_tintDirty = true;
+    m_brushDirty = true;
+}
+
+void QtAcrylicEffectHelper::updateDirtyResources()
+{
+    QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::UpdateBrush, this);
+    const uint themeGeneration = g_themeGeneration;
+    trace.setCacheHit(!m_brushDirty && !m_tintDirty && !m_acrylicBrushDirty && (m_themeGeneration == themeGeneration));
+    if (m_themeGeneration != themeGeneration) {
+        m_themeGeneration = themeGeneration;
+        m_maskColor = (Utilities::isDarkThemeEnabled() ? Qt::darkGray : Qt::white);
+        // The tint falls back to the mask color.
+        m_tintDirty = true;
+    }
+    if (m_brushDirty) {
+        const QPair<int, int> key = {m_noiseTileSize, toPermille(m_noiseIntensity)};
+        const QImage *cached = acrylicData()->noiseTextures.object(key);
+        if (cached) {
+            m_noiseTexture = *cached;
+        } else {
+            m_noiseTexture = Utilities::generateNoiseTexture({m_noiseTileSize, m_noiseTileSize}, m_noiseIntensity);
+            const int cost = qMax(1, int(imageBytes(m_noiseTexture) / 1024));
+            acrylicData()->noiseTextures.insert(key, new QImage(m_noiseTexture), cost);
+        }
+        // The texture is shared by all helpers using the same tile size and
+        // intensity, the brush only holds a reference to it.
+        m_noiseBrush = QBrush(m_noiseTexture);
+        m_brushDirty = false;
+        m_acrylicBrushDirty = true;
     }
+    if (m_tintDirty) {
+        // Fold the soft light layer and the tint layer into one solid color, they
+        // are both uniform so there is no need to paint them into a texture.
+        QColor baseColor = Qt::transparent;
+#ifdef Q_OS_WINDOWS
+        if (!Utilities::isOfficialMSWin10AcrylicBlurAvailable()) {
+            // Add a soft light layer for the background.
+            baseColor = defaultMaskColor();
+            baseColor.setAlpha(150);
+        }
 #endif
-    if (aspectStyle == Utilities::DesktopWallpaperAspectStyle::IgnoreRatioFit ||
-            aspectStyle == Utilities::DesktopWallpaperAspectStyle::KeepRatioFit ||
-            aspectStyle == Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding) {
-        Qt::AspectRatioMode mode;
-        if (aspectStyle == Utilities::DesktopWallpaperAspectStyle::IgnoreRatioFit) {
-            mode = Qt::IgnoreAspectRatio;
-        } else if (aspectStyle == Utilities::DesktopWallpaperAspectStyle::KeepRatioFit) {
-            mode = Qt::KeepAspectRatio;
+        const QColor &tintColor = getAppropriateTintColor(m_alternativeTintColor);
+        if (m_materialMode == MaterialMode::Fluent) {
+            m_fluentBlendTables = Utilities::createFluentBlendTables(tintColor, m_tintOpacity, m_luminosityOpacity);
+        }
+        const qreal srcAlpha = tintColor.alphaF() * qBound(qreal(0), m_tintOpacity, qreal(1));
+        const qreal dstAlpha = baseColor.alphaF();
+        const qreal outAlpha = srcAlpha + dstAlpha * (1 - srcAlpha);
+        if (outAlpha <= 0) {
+            m_tintFillColor = Qt::transparent;
         } else {
-            mode = Qt::KeepAspectRatioByExpanding;
+            const auto blend = [srcAlpha, dstAlpha, outAlpha](const qreal src, const qreal dst) -> qreal {
+                return ((src * srcAlpha) + (dst * dstAlpha * (1 - srcAlpha))) / outAlpha;
+            };
+            m_tintFillColor = QColor::fromRgbF(blend(tintColor.redF(), baseColor.redF()),
+                                               blend(tintColor.greenF(), baseColor.greenF()),
+                                               blend(tintColor.blueF(), baseColor.blueF()),
+                                               outAlpha);
         }
-        QSize newSize = image.size();
-        newSize.scale(size, mode);
-        image = image.scaled(newSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        // The cheapest quality tier paints this instead of the backdrop, it must
+        // be opaque, so put the tint over the plain mask color.
+        const QColor &maskColor = defaultMaskColor();
+        const qreal fillAlpha = m_tintFillColor.alphaF();
+        m_solidFallbackColor = QColor::fromRgbF((m_tintFillColor.redF() * fillAlpha) + (maskColor.redF() * (1 - fillAlpha)),
+                                                (m_tintFillColor.greenF() * fillAlpha) + (maskColor.greenF() * (1 - fillAlpha)),
+                                                (m_tintFillColor.blueF() * fillAlpha) + (maskColor.blueF() * (1 - fillAlpha)));
+        m_tintDirty = false;
+        m_acrylicBrushDirty = true;
     }
-    if (aspectStyle == Utilities::DesktopWallpaperAspectStyle::Tiled) {
-        QPainter painterBuffer(&buffer);
-        painterBuffer.fillRect(QRect{{0, 0}, size}, image);
-    } else {
-        QPainter painterBuffer(&buffer);
-        const QRect rect = Utilities::alignedRect(Qt::LeftToRight, Qt::AlignCenter, image.size(), {{0, 0}, size});
-        painterBuffer.drawImage(rect.topLeft(), image);
+    if (m_acrylicBrushDirty) {
+        // Release the tile first, so that it isn't shared anymore and is painted
+        // in place: animating the tint or the noise opacity doesn't allocate.
+        m_acrylicBrush = {};
+        if (m_acrylicBrushTile.size() != m_noiseTexture.size()) {
+            m_acrylicBrushTile = QImage(m_noiseTexture.size(), QImage::Format_ARGB32_Premultiplied);
+        }
+        m_acrylicBrushTile.fill(m_tintFillColor);
+        {
+            QPainter painter(&m_acrylicBrushTile);
+            painter.setOpacity(qBound(qreal(0), m_noiseOpacity, qreal(1)));
+            painter.drawImage(QPoint{0, 0}, m_noiseTexture);
+        }
+        m_acrylicBrush = QBrush(m_acrylicBrushTile);
+        m_acrylicBrushDirty = false;
+    }
+}
+
+void QtAcrylicEffectHelper::generateBluredWallpaper(QPixmap recycled)
+{
+    watchScreens();
+    QtAcrylicWallpaperData &data = wallpaperData();
+    if (!data.bluredWallpaper.isNull()) {
+        return;
+    }
+    // Generated in backdrop pixels, the scale is only set at the end, otherwise the
+    // painter would scale everything up a second time.
+    const QSize size = primaryScreenSize() * m_backdropScale;
+    const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::GenerateWallpaper, this, size);
+    // A full screen allocation isn't free, the outdated wallpaper is painted over
+    // when the size didn't change.
+    data.bluredWallpaper = ((recycled.size() == size) ? std::move(recycled) : QPixmap(size));
+    data.bluredWallpaper.setDevicePixelRatio(1.0);
+    data.bluredWallpaper.fill(Qt::transparent);
+    data.blurRadius = m_blurRadius;
+    data.wallpaperGeneration = g_wallpaperGeneration;
+    data.screenGeneration = g_screenGeneration;
+    const auto tagWallpaper = qScopeGuard([&data, this](){
+        data.bluredWallpaper.setDevicePixelRatio(m_backdropScale);
+    });
+    const bool overridden = !acrylicData()->wallpaperOverride.isNull();
+    const QImage image = (overridden ? acrylicData()->wallpaperOverride : Utilities::getDesktopWallpaperImage());
+    // On some platforms we may not be able to get the desktop wallpaper, such as Linux and WebAssembly.
+    if (image.isNull() || size.isEmpty()) {
+        return;
+    }
+    const Utilities::DesktopWallpaperAspectStyle aspectStyle = (overridden ? acrylicData()->wallpaperOverrideAspectStyle
+                                                                           : Utilities::getDesktopWallpaperAspectStyle());
+#ifdef Q_OS_WINDOWS
+    const QColor backgroundColor = (overridden ? QColor{} : Utilities::getDesktopBackgroundColor());
+#else
+    const QColor backgroundColor = {};
+#endif
+    QImage buffer = Utilities::composeDesktopWallpaper(image, size, aspectStyle, backgroundColor);
+    // Centered and fitted wallpapers without a background color leave bars, and the
+    // override may be translucent. Only a fully covered screen is opaque.
+    data.opaque = isFullyOpaque(buffer);
+    if (data.opaque) {
+        // The blur fades towards the edges, its accumulators start from transparent
+        // pixels. Over black, the premultiplied colors stay the same and every pixel
+        // ends up as opaque as isOpaque() claims.
+        data.bluredWallpaper.fill(Qt::black);
     }
-    QPainter painter(&acrylicData()->bluredWallpaper);
+    QPainter painter(&data.bluredWallpaper);
 #if 1
-    Utilities::blurImage(&painter, buffer, 128, false, false);
+    Utilities::blurImage(&painter, buffer, m_blurRadius * m_backdropScale, false, false);
 #else
     painter.drawImage(QPoint{0, 0}, buffer);
 #endif
@@ -231,8 +1228,8 @@ void QtAcrylicEffectHelper::generateBluredWallpaper()
 
 const QColor &QtAcrylicEffectHelper::defaultMaskColor() const
 {
-    static const QColor color = Utilities::isDarkThemeEnabled() ? Qt::darkGray : Qt::white;
-    return color;
+    // Refreshed by updateDirtyResources() when the theme changes.
+    return m_maskColor;
 }
 
 const QColor &QtAcrylicEffectHelper::getAppropriateTintColor(const QColor &alternativeTintColor) const
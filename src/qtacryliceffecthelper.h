@@ -26,12 +26,57 @@
 
 #include "qtacrylichelper_global.h"
 #include <QtGui/qbrush.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qregion.h>
+#include "utilities.h"
+#include "qtacrylicqualitygovernor.h"
+#include <memory>
+
+struct QtAcrylicWallpaperData;
+struct QtAcrylicConfig;
 
 class QTACRYLICHELPER_API QtAcrylicEffectHelper
 {
     Q_DISABLE_COPY_MOVE(QtAcrylicEffectHelper)
 
 public:
+    enum class MaterialMode
+    {
+        Default, // Tint and soft light layers blended over the backdrop.
+        Fluent // Luminosity and color blends, as the Fluent Design acrylic recipe.
+    };
+
+    // The material as separate layers, for renderers that blend them on their own,
+    // such as the Qt Quick scene graph. Drawn in order: the base color where the
+    // backdrop doesn't reach (off the primary screen), the backdrop (sampled at the
+    // global position of the surface), the fill color and the noise (tiled and
+    // anchored to the screen).
+    struct Layers
+    {
+        QColor baseColor = {}; // Invalid unless the backdrop is opaque.
+        QPixmap backdrop = {}; // Null in the solid color tier.
+        qreal backdropScale = 1.0; // Backdrop pixels per device independent pixel.
+        bool opaqueBackdrop = false;
+        QColor fillColor = {};
+        QImage noiseTexture = {}; // Null when no noise should be drawn.
+        qreal noiseOpacity = 0.0;
+    };
+
+    // Bytes held by the caches shared by all the surfaces.
+    struct MemoryUsage
+    {
+        qint64 wallpapers = 0; // The blured wallpapers and their derived copies, for every backdrop scale.
+        qint64 composedBackdrops = 0;
+        qint64 noiseTextures = 0;
+        qint64 cornerMasks = 0;
+        qint64 textures = 0; // Uploaded by the surfaces themselves, see reportTextureMemory().
+
+        qint64 total() const
+        {
+            return (wallpapers + composedBackdrops + noiseTextures + cornerMasks + textures);
+        }
+    };
+
     explicit QtAcrylicEffectHelper();
     ~QtAcrylicEffectHelper();
 
@@ -44,22 +89,141 @@ public:
     void setNoiseOpacity(const qreal value);
     qreal getNoiseOpacity() const;
 
-    const QBrush &getAcrylicBrush() const;
+    // Clamped to [8, 512] pixels.
+    void setNoiseTileSize(const int value);
+    int getNoiseTileSize() const;
+
+    // Strength of the grain itself, [0, 1]. Unlike the noise opacity, changing it
+    // generates a new noise texture.
+    void setNoiseIntensity(const qreal value);
+    qreal getNoiseIntensity() const;
+
+    void setMaterialMode(const MaterialMode value);
+    MaterialMode getMaterialMode() const;
+
+    void setLuminosityOpacity(const qreal value);
+    qreal getLuminosityOpacity() const;
+
+    void setBackdropCacheEnabled(const bool value);
+    bool isBackdropCacheEnabled() const;
+
+    // Rounds the corners of the surface, in device independent pixels.
+    void setCornerRadius(const int value);
+    int getCornerRadius() const;
+
+    // Whether paintBackground() covers the whole surface with opaque pixels, in
+    // which case nothing below the surface needs to be painted.
+    bool isOpaque() const;
+    // The part of a surface of the given size that paintBackground() covers with
+    // opaque pixels. Unlike isOpaque(), the rounded corners only remove the corner
+    // squares instead of the whole surface.
+    QRegion getOpaqueRegion(const QSize &size) const;
+
+    // Replaces the application wide QtAcrylicConfig for this surface only.
+    void setConfigOverride(const QtAcrylicConfig &value);
+    void clearConfigOverride();
+    std::shared_ptr<const QtAcrylicConfig> getConfig() const;
+    bool isWallpaperBlurActive() const;
+
+    // The tint and the noise in one tile, the same brush paintBackground() fills
+    // the surface with on top of the backdrop. The dirty resources are brought up
+    // to date first, hence not const.
+    const QBrush &getAcrylicBrush();
     const QPixmap &getBluredWallpaper() const;
     void showPerformanceWarning() const;
     void regenerateWallpaper();
 
-    void paintBackground(QPainter *painter, const QRect &rect);
+    // Invalidate what depends on the system state, for all the surfaces. Only the
+    // affected caches are rebuilt, on the next paint.
+    static void notifyThemeChanged();
+    static void notifyWallpaperChanged();
+    static void notifyScreensChanged();
+
+    // Blurs the given image instead of the desktop wallpaper, for all the surfaces.
+    // Useful where the wallpaper can't be read and to render without a desktop
+    // session. A valid screen size replaces the size of the primary screen.
+    static void setWallpaperOverride(const QImage &wallpaper, const _qam::Utilities::DesktopWallpaperAspectStyle aspectStyle,
+                                     const QSize &screenSize = {});
+    static void clearWallpaperOverride();
+
+    // The caches are kept within QtAcrylicSettings::cacheMemoryBudget(), least
+    // recently painted entries first. A wallpaper painted in the last few seconds
+    // is never evicted.
+    static MemoryUsage memoryUsage();
+    // For the surfaces that upload textures of their own (QtAcrylicItem), counted
+    // against the budget. Positive when allocated, negative when freed, from any
+    // thread.
+    static void reportTextureMemory(const qint64 bytes);
+
+    // "rect" is the area of the surface in global coordinates, "region" is the part
+    // of the surface (in its own coordinates) that needs to be repainted. An empty
+    // region repaints the whole surface. Without a device pixel ratio, the one of
+    // the paint device is used.
+    void paintBackground(QPainter *painter, const QRect &rect, const QRegion &region = {}, const qreal devicePixelRatio = 0);
     void updateAcrylicBrush(const QColor &alternativeTintColor = {});
 
+    // Whether the current settings can be rendered with getLayers(). Rounded corners,
+    // the Fluent material and the OS blur need paintBackground().
+    bool canCompositeLayers() const;
+    // May generate the wallpaper, so GUI thread only, like paintBackground().
+    Layers getLayers(const qreal devicePixelRatio);
+
 private:
-    void generateBluredWallpaper();
+    // "recycled" is the outdated wallpaper, painted again when it has the right size.
+    void generateBluredWallpaper(QPixmap recycled = {});
+    // "config" is the snapshot taken once by paintBackground(), the global one may
+    // change in the middle of a paint and isn't free to load either.
+    void compositeBackground(QPainter *painter, const QtAcrylicConfig &config, const QRect &rect, const QRect &localRect,
+                             const QtAcrylicQualityGovernor::Tier tier, const QPixmap *composedBackdrop);
+    void updateDirtyResources();
+    const QPixmap *getComposedBackdrop(const QtAcrylicConfig &config);
+    void paintCorner(QPainter *painter, const QtAcrylicConfig &config, const QRect &rect, const QRect &cornerRect,
+                     const int corner, const QtAcrylicQualityGovernor::Tier tier, const QPixmap *composedBackdrop);
+    const QImage &getCornerMask(const int radius) const;
+    bool isFluentBlendActive(const QtAcrylicConfig &config) const;
+    bool isBackdropOpaque() const;
+    QtAcrylicWallpaperData &wallpaperData() const;
+    void loadSettings(const qreal devicePixelRatio);
+    qreal effectiveNoiseOpacity() const;
+    qint64 ensureBluredWallpaper();
+    const QImage &getBluredWallpaperImage() const;
+    void paintFluentBackdrop(QPainter *painter, const QRect &rect);
     const QColor &defaultMaskColor() const;
     const QColor &getAppropriateTintColor(const QColor &alternativeTintColor = {}) const;
 
 private:
     QBrush m_acrylicBrush = {};
+    QImage m_acrylicBrushTile = {};
+    QBrush m_noiseBrush = {};
+    QImage m_noiseTexture = {};
     QColor m_tintColor = {};
+    QColor m_alternativeTintColor = {};
+    QColor m_tintFillColor = {};
+    QColor m_solidFallbackColor = {};
     qreal m_tintOpacity = 0.7;
     qreal m_noiseOpacity = 0.04;
+    qreal m_noiseIntensity = 1.0;
+    qreal m_luminosityOpacity = 0.8;
+    qreal m_devicePixelRatio = 1.0;
+    // Cached from QtAcrylicSettings and the quality governor at the beginning of
+    // each paint.
+    QtAcrylicQualityGovernor::Tier m_tier = QtAcrylicQualityGovernor::Tier::Full;
+    qreal m_backdropScale = 1.0;
+    qreal m_blurRadius = 128.0;
+    bool m_noiseEnabled = true;
+    MaterialMode m_materialMode = MaterialMode::Default;
+    _qam::Utilities::FluentBlendTables m_fluentBlendTables = {};
+    QImage m_fluentScratchImage = {};
+    QImage m_cornerScratchImage = {};
+    int m_cornerRadius = 0;
+    int m_noiseTileSize = 64;
+    bool m_brushDirty = true;
+    bool m_acrylicBrushDirty = true;
+    bool m_tintDirty = true;
+    bool m_backdropCacheEnabled = false;
+    uint m_composedBackdropKey = 0;
+    int m_composedBackdropStableFrames = 0;
+    std::shared_ptr<const QtAcrylicConfig> m_configOverride = nullptr;
+    QColor m_maskColor = {};
+    uint m_themeGeneration = 0;
 };
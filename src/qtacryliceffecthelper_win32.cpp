@@ -24,6 +24,8 @@
 
 #include "qtacryliceffecthelper_win32.h"
 #include "utilities.h"
+#include "qtacryliceffecthelper.h"
+#include "qtacrylicwindowtracker.h"
 #include <QtCore/qt_windows.h>
 #include <QtCore/qcoreapplication.h>
 
@@ -101,18 +103,24 @@ bool QtAcrylicWinEventFilter::nativeEventFilter(const QByteArray &eventType, voi
     switch (msg->message) {
     case WM_SETTINGCHANGE: {
         if (msg->wParam == SPI_SETDESKWALLPAPER) {
+            QtAcrylicEffectHelper::notifyWallpaperChanged();
             shouldClearWallpaper = true;
             shouldUpdate = true;
         }
         if ((msg->wParam == 0) && (QString::fromWCharArray(reinterpret_cast<LPCWSTR>(msg->lParam)) == QStringLiteral("ImmersiveColorSet"))) {
+            QtAcrylicEffectHelper::notifyThemeChanged();
             shouldUpdate = true;
         }
     } break;
     case WM_DPICHANGED: {
+        QtAcrylicEffectHelper::notifyScreensChanged();
         shouldClearWallpaper = true;
         shouldUpdate = true;
     } break;
     case WM_THEMECHANGED:
+        QtAcrylicEffectHelper::notifyThemeChanged();
+        shouldUpdate = true;
+        break;
     case WM_DWMCOMPOSITIONCHANGED:
     case WM_DWMCOLORIZATIONCOLORCHANGED:
         shouldUpdate = true;
@@ -125,6 +133,11 @@ bool QtAcrylicWinEventFilter::nativeEventFilter(const QByteArray &eventType, voi
         if (window) {
             QtAcrylicWinUpdateEvent event(shouldClearWallpaper);
             QCoreApplication::sendEvent(const_cast<QWindow *>(window), &event);
+            // The caches are rebuilt lazily, the surfaces just need to be repainted.
+            const auto tracker = window->findChild<QtAcrylicWindowTracker *>(QString{}, Qt::FindDirectChildrenOnly);
+            if (tracker) {
+                tracker->scheduleUpdates();
+            }
         }
     }
     return false;
@@ -70,5 +70,6 @@ namespace _qam::Global {
 [[maybe_unused]] const char _qam_forceDisableTraditionalBlur_flag[] = "_QTACRYLICMATERIAL_FORCE_DISABLE_TRADITIONAL_BLUR";
 [[maybe_unused]] const char _qam_forceEnableWallpaperBlur_flag[] = "_QTACRYLICMATERIAL_FORCE_ENABLE_WALLPAPER_BLUR";
 [[maybe_unused]] const char _qam_forceDisableWallpaperBlur_flag[] = "_QTACRYLICMATERIAL_FORCE_DISABLE_WALLPAPER_BLUR";
+[[maybe_unused]] const char _qam_trace_flag[] = "_QTACRYLICMATERIAL_TRACE";
 
 }
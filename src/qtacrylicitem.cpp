@@ -23,52 +23,500 @@
  */
 
 #include "qtacrylicitem.h"
+#include <QtQml/qqml.h>
+#include <QtQml/qqmlengine.h>
 #include <QtQuick/qquickwindow.h>
+#include <QtQuick/qsgimagenode.h>
+#include <QtQuick/qsgrectanglenode.h>
+#include <QtGui/qguiapplication.h>
+#include <QtGui/qpainter.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qset.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qmath.h>
 #include "utilities.h"
+#include "qtacrylicqualitygovernor.h"
+#include "qtacrylicsettings.h"
+#include "qtacrylicwindowtracker.h"
 
 using namespace _qam;
 
-QtAcrylicItem::QtAcrylicItem(QQuickItem *parent) : QQuickPaintedItem(parent)
+// Smallest side of the noise texture of a node, rounded up to whole noise tiles.
+static constexpr const int kNoiseBlockSize = 256;
+
+struct QtAcrylicSharedTexture {
+    QSGTexture *texture = nullptr;
+    int refCount = 0;
+};
+
+// The backdrop textures are shared by all the acrylic items of a window, each
+// wallpaper is only uploaded once per window. They live on the render thread
+// of their window, hence the mutex.
+struct QtAcrylicItemData {
+    QMutex mutex;
+    QHash<QQuickWindow *, QHash<qint64, QtAcrylicSharedTexture>> textures = {};
+    QSet<QQuickWindow *> watchedWindows = {};
+};
+
+Q_GLOBAL_STATIC(QtAcrylicItemData, acrylicItemData)
+
+// Every texture of the items goes through these two, so that it is counted in
+// QtAcrylicEffectHelper::memoryUsage(). All of them have 32 bits per pixel.
+static inline qint64 textureBytes(const QSGTexture *texture)
 {
-    m_acrylicHelper.showPerformanceWarning();
-    m_acrylicHelper.updateAcrylicBrush();
-    connect(this, &QtAcrylicItem::xChanged, this, [this](){
-        if (Utilities::shouldUseWallpaperBlur()) {
-            update();
+    const QSize size = texture->textureSize();
+    return (qint64(size.width()) * size.height() * 4);
+}
+
+static inline QSGTexture *createTexture(QQuickWindow *window, const QImage &image)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return nullptr;
+    }
+    QSGTexture *texture = window->createTextureFromImage(image);
+    if (texture) {
+        QtAcrylicEffectHelper::reportTextureMemory(textureBytes(texture));
+    }
+    return texture;
+}
+
+static inline void deleteTexture(QSGTexture *texture)
+{
+    if (!texture) {
+        return;
+    }
+    QtAcrylicEffectHelper::reportTextureMemory(-textureBytes(texture));
+    delete texture;
+}
+
+static inline void releaseWindowTextures(QQuickWindow *window)
+{
+    QMutexLocker locker(&acrylicItemData()->mutex);
+    const auto textures = acrylicItemData()->textures.take(window);
+    for (auto &&texture : qAsConst(textures)) {
+        deleteTexture(texture.texture);
+    }
+}
+
+static inline QSGTexture *acquireBackdropTexture(QQuickWindow *window, const QPixmap &backdrop, const bool opaque)
+{
+    Q_ASSERT(window);
+    Q_ASSERT(!backdrop.isNull());
+    if (!window || backdrop.isNull()) {
+        return nullptr;
+    }
+    QMutexLocker locker(&acrylicItemData()->mutex);
+    if (!acrylicItemData()->watchedWindows.contains(window)) {
+        acrylicItemData()->watchedWindows.insert(window);
+        // Emitted on the render thread, once all the nodes are gone.
+        QObject::connect(window, &QQuickWindow::sceneGraphInvalidated, window, [window](){
+            releaseWindowTextures(window);
+        }, Qt::DirectConnection);
+        QObject::connect(window, &QObject::destroyed, qApp, [window](){
+            QMutexLocker locker(&acrylicItemData()->mutex);
+            acrylicItemData()->watchedWindows.remove(window);
+        });
+    }
+    QtAcrylicSharedTexture &shared = acrylicItemData()->textures[window][backdrop.cacheKey()];
+    if (!shared.texture) {
+        // Let the renderer skip blending when the wallpaper covers everything.
+        const QImage image = backdrop.toImage();
+        shared.texture = createTexture(window, (opaque ? image.convertToFormat(QImage::Format_RGB32) : image));
+    }
+    ++shared.refCount;
+    return shared.texture;
+}
+
+static inline void releaseBackdropTexture(QQuickWindow *window, const qint64 key)
+{
+    QMutexLocker locker(&acrylicItemData()->mutex);
+    const auto windowIt = acrylicItemData()->textures.find(window);
+    if (windowIt == acrylicItemData()->textures.end()) {
+        return;
+    }
+    const auto it = windowIt->find(key);
+    if (it == windowIt->end()) {
+        return;
+    }
+    if (--it->refCount <= 0) {
+        deleteTexture(it->texture);
+        windowIt->erase(it);
+    }
+}
+
+// Either the material as separate nodes (a backdrop sampled at the global position
+// of the item, the fill color and the tiled noise), or, for what the scene graph
+// can't do on its own, a single texture painted by QtAcrylicEffectHelper.
+class QtAcrylicItemNode : public QSGNode
+{
+public:
+    explicit QtAcrylicItemNode(QQuickWindow *window) : m_window(window) {}
+
+    ~QtAcrylicItemNode() override
+    {
+        releaseTextures();
+    }
+
+    void updateLayers(const QtAcrylicEffectHelper::Layers &layers, const QRectF &rect, const QPoint &globalPosition)
+    {
+        const bool hasBase = layers.baseColor.isValid();
+        const bool hasBackdrop = !layers.backdrop.isNull();
+        const bool hasNoise = !layers.noiseTexture.isNull();
+        if (m_rasterNode || !m_fillNode || ((m_baseNode != nullptr) != hasBase)
+                || ((m_backdropNode != nullptr) != hasBackdrop) || ((m_noiseOpacityNode != nullptr) != hasNoise)) {
+            reset();
+            if (hasBase) {
+                m_baseNode = m_window->createRectangleNode();
+                appendChildNode(m_baseNode);
+            }
+            if (hasBackdrop) {
+                m_backdropNode = m_window->createImageNode();
+                m_backdropNode->setFiltering(QSGTexture::Linear);
+                appendChildNode(m_backdropNode);
+            }
+            m_fillNode = m_window->createRectangleNode();
+            appendChildNode(m_fillNode);
+            if (hasNoise) {
+                m_noiseOpacityNode = new QSGOpacityNode;
+                appendChildNode(m_noiseOpacityNode);
+            }
         }
-    });
-    connect(this, &QtAcrylicItem::yChanged, this, [this](){
-        if (Utilities::shouldUseWallpaperBlur()) {
-            update();
+        if (hasBackdrop) {
+            const qint64 backdropKey = layers.backdrop.cacheKey();
+            if (backdropKey != m_backdropKey) {
+                QSGTexture *texture = acquireBackdropTexture(m_window, layers.backdrop, layers.opaqueBackdrop);
+                releaseBackdropTexture(m_window, m_backdropKey);
+                m_backdropKey = backdropKey;
+                m_backdropNode->setTexture(texture);
+            }
+            // Moving the item only moves the source rectangle, nothing is repainted.
+            // The backdrop only covers the primary screen, the base color shows
+            // elsewhere instead of the clamped edge of the texture.
+            const QRectF globalRect = {QPointF(globalPosition), rect.size()};
+            const QRectF backdropRect = {QPointF{0, 0}, QSizeF(layers.backdrop.size()) / layers.backdropScale};
+            const QRectF coveredRect = globalRect.intersected(backdropRect);
+            m_backdropNode->setRect(coveredRect.isEmpty() ? QRectF{} : coveredRect.translated(rect.topLeft() - globalRect.topLeft()));
+            m_backdropNode->setSourceRect({coveredRect.topLeft() * layers.backdropScale, coveredRect.size() * layers.backdropScale});
+            if (hasBase) {
+                m_baseNode->setRect((coveredRect == globalRect) ? QRectF{} : rect);
+                m_baseNode->setColor(layers.baseColor);
+            }
         }
-    });
-    connect(this, &QtAcrylicItem::windowChanged, this, [this](QQuickWindow *w){
-        if (Utilities::shouldUseWallpaperBlur()) {
-            if (m_xConnection) {
-                disconnect(m_xConnection);
+        m_fillNode->setRect(rect);
+        m_fillNode->setColor(layers.fillColor);
+        if (hasNoise) {
+            updateNoise(layers, rect, globalPosition);
+        }
+    }
+
+    void updateRaster(const QImage &image, const QRectF &rect)
+    {
+        if (!m_rasterNode) {
+            reset();
+            m_rasterNode = m_window->createImageNode();
+            m_rasterNode->setFiltering(QSGTexture::Linear);
+            appendChildNode(m_rasterNode);
+        }
+        // A texture can't be refilled through the public API, but it only has to be
+        // uploaded again when the item actually painted something new.
+        if (image.cacheKey() != m_rasterKey) {
+            QSGTexture *texture = createTexture(m_window, image);
+            m_rasterNode->setTexture(texture);
+            deleteTexture(m_rasterTexture);
+            m_rasterTexture = texture;
+            m_rasterKey = image.cacheKey();
+        }
+        m_rasterNode->setRect(rect);
+        m_rasterNode->setSourceRect(QRectF{QPointF{0, 0}, QSizeF(image.size())});
+    }
+
+private:
+    void updateNoise(const QtAcrylicEffectHelper::Layers &layers, const QRectF &rect, const QPoint &globalPosition)
+    {
+        // Not every backend can repeat a texture, and QSGImageNode can't ask for it
+        // anyway. The tile is repeated into a small block instead, which is laid out
+        // on a grid aligned to the screen (keeping the grain anchored to it) by as
+        // many image nodes as needed. They all share the texture, so the renderer
+        // batches them into a single draw call.
+        const int tileSize = qMax(1, layers.noiseTexture.width());
+        const int blockSize = (qCeil(qreal(kNoiseBlockSize) / qreal(tileSize)) * tileSize);
+        const qint64 noiseKey = layers.noiseTexture.cacheKey();
+        if (noiseKey != m_noiseKey) {
+            QImage image(blockSize, blockSize, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+            {
+                QPainter painter(&image);
+                painter.fillRect(image.rect(), QBrush(layers.noiseTexture));
             }
-            if (m_yConnection) {
-                disconnect(m_yConnection);
+            QSGTexture *texture = createTexture(m_window, image);
+            for (auto &&noiseNode : qAsConst(m_noiseNodes)) {
+                noiseNode->setTexture(texture);
             }
-            if (w) {
-                m_xConnection = connect(w, &QQuickWindow::xChanged, this, [this](){
-                    update();
-                });
-                m_yConnection = connect(w, &QQuickWindow::yChanged, this, [this](){
-                    update();
-                });
+            deleteTexture(m_noiseTexture);
+            m_noiseTexture = texture;
+            m_noiseKey = noiseKey;
+        }
+        m_noiseOpacityNode->setOpacity(layers.noiseOpacity);
+        const QRectF globalRect = {QPointF(globalPosition), rect.size()};
+        const int firstColumn = qFloor(globalRect.left() / blockSize);
+        const int firstRow = qFloor(globalRect.top() / blockSize);
+        const int columns = (qCeil((globalRect.left() + globalRect.width()) / blockSize) - firstColumn);
+        const int rows = (qCeil((globalRect.top() + globalRect.height()) / blockSize) - firstRow);
+        const int count = (columns * rows);
+        while (m_noiseNodes.size() < count) {
+            QSGImageNode *noiseNode = m_window->createImageNode();
+            noiseNode->setFiltering(QSGTexture::Nearest);
+            noiseNode->setTexture(m_noiseTexture);
+            m_noiseOpacityNode->appendChildNode(noiseNode);
+            m_noiseNodes.append(noiseNode);
+        }
+        while (m_noiseNodes.size() > count) {
+            QSGImageNode *noiseNode = m_noiseNodes.takeLast();
+            m_noiseOpacityNode->removeChildNode(noiseNode);
+            delete noiseNode;
+        }
+        const QPointF offset = (rect.topLeft() - globalRect.topLeft());
+        for (int row = 0; row != rows; ++row) {
+            for (int column = 0; column != columns; ++column) {
+                const QPointF blockOrigin = {qreal((firstColumn + column) * blockSize), qreal((firstRow + row) * blockSize)};
+                const QRectF blockRect = QRectF{blockOrigin, QSizeF(blockSize, blockSize)}.intersected(globalRect);
+                QSGImageNode *noiseNode = m_noiseNodes.at((row * columns) + column);
+                noiseNode->setRect(blockRect.translated(offset));
+                noiseNode->setSourceRect(blockRect.translated(-blockOrigin));
             }
         }
+    }
+
+    void releaseTextures()
+    {
+        if (m_backdropKey != 0) {
+            releaseBackdropTexture(m_window, m_backdropKey);
+            m_backdropKey = 0;
+        }
+        deleteTexture(m_noiseTexture);
+        m_noiseTexture = nullptr;
+        m_noiseKey = 0;
+        deleteTexture(m_rasterTexture);
+        m_rasterTexture = nullptr;
+        m_rasterKey = 0;
+    }
+
+    void reset()
+    {
+        while (QSGNode *child = firstChild()) {
+            removeChildNode(child);
+            delete child;
+        }
+        releaseTextures();
+        m_baseNode = nullptr;
+        m_backdropNode = nullptr;
+        m_fillNode = nullptr;
+        m_noiseOpacityNode = nullptr;
+        m_noiseNodes.clear();
+        m_rasterNode = nullptr;
+    }
+
+private:
+    QQuickWindow *m_window = nullptr;
+    QSGRectangleNode *m_baseNode = nullptr;
+    QSGImageNode *m_backdropNode = nullptr;
+    qint64 m_backdropKey = 0;
+    QSGRectangleNode *m_fillNode = nullptr;
+    QSGOpacityNode *m_noiseOpacityNode = nullptr;
+    QVector<QSGImageNode *> m_noiseNodes = {};
+    QSGTexture *m_noiseTexture = nullptr;
+    qint64 m_noiseKey = 0;
+    QSGImageNode *m_rasterNode = nullptr;
+    QSGTexture *m_rasterTexture = nullptr;
+    qint64 m_rasterKey = 0;
+};
+
+// The QML types of the library, available as soon as the application exists.
+static void registerQmlTypes()
+{
+    static const char uri[] = "wangwenx190.Utils";
+    qmlRegisterType<QtAcrylicItem>(uri, 1, 0, "AcrylicItem");
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    qmlRegisterSingletonInstance(uri, 1, 0, "AcrylicSettings", QtAcrylicSettings::instance());
+#else
+    qmlRegisterSingletonType<QtAcrylicSettings>(uri, 1, 0, "AcrylicSettings",
+                                                [](QQmlEngine *, QJSEngine *) -> QObject * {
+        QtAcrylicSettings *settings = QtAcrylicSettings::instance();
+        QQmlEngine::setObjectOwnership(settings, QQmlEngine::CppOwnership);
+        return settings;
+    });
+#endif
+}
+
+Q_COREAPP_STARTUP_FUNCTION(registerQmlTypes)
+
+QtAcrylicItem::QtAcrylicItem(QQuickItem *parent) : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+    m_acrylicHelper.showPerformanceWarning();
+    m_acrylicHelper.updateAcrylicBrush();
+    connect(QtAcrylicQualityGovernor::instance(), &QtAcrylicQualityGovernor::tierChanged, this, [this](){
+        repaintBackground();
+    });
+    connect(QtAcrylicSettings::instance(), &QtAcrylicSettings::settingsChanged, this, [this](){
+        repaintBackground();
+    });
+    connect(this, &QtAcrylicItem::widthChanged, this, &QtAcrylicItem::repaintBackground);
+    connect(this, &QtAcrylicItem::heightChanged, this, &QtAcrylicItem::repaintBackground);
+    connect(this, &QtAcrylicItem::xChanged, this, &QtAcrylicItem::positionChanged);
+    connect(this, &QtAcrylicItem::yChanged, this, &QtAcrylicItem::positionChanged);
+    m_parentConnection = connect(this, &QtAcrylicItem::parentChanged, this, [this](){
+        watchAncestors();
+        positionChanged();
     });
+    watchAncestors();
+    // Window moves are dispatched by the tracker of the window, shared by all the
+    // acrylic items inside it.
+    m_windowConnection = connect(this, &QtAcrylicItem::windowChanged, this, [this](QQuickWindow *w){
+        if (m_windowTracker) {
+            m_windowTracker->unregisterSurface(this);
+        }
+        m_windowTracker = (w ? QtAcrylicWindowTracker::get(w) : nullptr);
+        if (m_windowTracker) {
+            m_windowTracker->registerSurface(this, [this](){
+                return mapToScene(QPointF{0.0, 0.0}).toPoint();
+            }, [this](){
+                repaintBackground();
+            }, [this](){
+                return m_acrylicHelper.isWallpaperBlurActive();
+            });
+        }
+        if (w) {
+            repaintBackground();
+        }
+    });
+}
+
+QtAcrylicItem::~QtAcrylicItem()
+{
+    // ~QQuickItem() detaches the item from its parent and its window, the handlers
+    // must not run on the members destroyed by then.
+    disconnect(m_parentConnection);
+    disconnect(m_windowConnection);
+    for (auto &&connection : qAsConst(m_ancestorConnections)) {
+        disconnect(connection);
+    }
+    m_ancestorConnections.clear();
+    if (m_windowTracker) {
+        m_windowTracker->unregisterSurface(this);
+    }
 }
 
-QtAcrylicItem::~QtAcrylicItem() = default;
+void QtAcrylicItem::positionChanged()
+{
+    if (m_windowTracker) {
+        m_windowTracker->invalidateOffset(this);
+    }
+    if (m_acrylicHelper.isWallpaperBlurActive()) {
+        scheduleUpdate();
+    }
+}
 
-void QtAcrylicItem::paint(QPainter *painter)
+void QtAcrylicItem::watchAncestors()
 {
-    const QRectF rectF = {mapToGlobal(QPointF{0.0, 0.0}), size()};
-    m_acrylicHelper.paintBackground(painter, rectF.toRect());
+    for (auto &&connection : qAsConst(m_ancestorConnections)) {
+        disconnect(connection);
+    }
+    m_ancestorConnections.clear();
+    // Flickables and views move their content item, not the items inside it, yet
+    // those end up somewhere else in the window.
+    for (QQuickItem *ancestor = parentItem(); ancestor; ancestor = ancestor->parentItem()) {
+        m_ancestorConnections.append(connect(ancestor, &QQuickItem::xChanged, this, &QtAcrylicItem::positionChanged));
+        m_ancestorConnections.append(connect(ancestor, &QQuickItem::yChanged, this, &QtAcrylicItem::positionChanged));
+        m_ancestorConnections.append(connect(ancestor, &QQuickItem::parentChanged, this, [this](){
+            watchAncestors();
+            positionChanged();
+        }));
+    }
+}
+
+void QtAcrylicItem::repaintBackground()
+{
+    // The helper is only used from the GUI thread, in updatePolish(). The render
+    // thread only gets its results.
+    polish();
+    update();
+}
+
+void QtAcrylicItem::scheduleUpdate()
+{
+    // Moves come in much faster than frames, only repaint once per frame.
+    if (m_windowTracker) {
+        m_windowTracker->scheduleUpdate(this);
+    } else {
+        repaintBackground();
+    }
+}
+
+void QtAcrylicItem::updatePolish()
+{
+    QQuickWindow *w = window();
+    const QRectF rect = boundingRect();
+    m_layers = {};
+    if (!w || rect.isEmpty()) {
+        m_rasterImage = {};
+        return;
+    }
+    // The scene graph work of the last frame ran on the render thread, the governor
+    // is only fed from this one.
+    if (m_nodeUpdateCost > 0) {
+        QtAcrylicQualityGovernor::instance()->reportPaintCost(m_nodeUpdateCost);
+        m_nodeUpdateCost = 0;
+    }
+    m_globalPosition = (m_windowTracker ? m_windowTracker->globalPosition(this) : mapToGlobal(QPointF{0.0, 0.0}).toPoint());
+    const qreal devicePixelRatio = w->effectiveDevicePixelRatio();
+    m_compositeLayers = m_acrylicHelper.canCompositeLayers();
+    if (m_compositeLayers) {
+        m_layers = m_acrylicHelper.getLayers(devicePixelRatio);
+        m_rasterImage = {};
+        return;
+    }
+    // Painted in place when the size doesn't change, no need for a new buffer
+    // every frame.
+    const QSize size = rect.size().toSize();
+    const QSize pixelSize = size * devicePixelRatio;
+    const QImage::Format format = (m_acrylicHelper.isOpaque() ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied);
+    if ((m_rasterImage.size() != pixelSize) || (m_rasterImage.format() != format)) {
+        m_rasterImage = QImage(pixelSize, format);
+    }
+    m_rasterImage.setDevicePixelRatio(devicePixelRatio);
+    m_rasterImage.fill(Qt::transparent);
+    QPainter painter(&m_rasterImage);
+    m_acrylicHelper.paintBackground(&painter, {m_globalPosition, size}, {}, devicePixelRatio);
+}
+
+QSGNode *QtAcrylicItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+    QQuickWindow *w = window();
+    const QRectF rect = boundingRect();
+    if (!w || rect.isEmpty() || (!m_compositeLayers && m_rasterImage.isNull())) {
+        delete oldNode;
+        return nullptr;
+    }
+    QElapsedTimer nodeUpdateTimer;
+    nodeUpdateTimer.start();
+    auto node = static_cast<QtAcrylicItemNode *>(oldNode);
+    if (!node) {
+        node = new QtAcrylicItemNode(w);
+    }
+    // Everything was prepared by updatePolish(), the GUI thread is blocked while
+    // this runs.
+    if (m_compositeLayers) {
+        node->updateLayers(m_layers, rect, m_globalPosition);
+    } else {
+        node->updateRaster(m_rasterImage, rect);
+    }
+    m_nodeUpdateCost += nodeUpdateTimer.nsecsElapsed();
+    return node;
 }
 
 QColor QtAcrylicItem::tintColor() const
@@ -94,8 +542,7 @@ void QtAcrylicItem::setTintColor(const QColor &value)
         pal.setColor(backgroundRole(), m_acrylicHelper.getTintColor());
         setPalette(pal);
 #endif
-        m_acrylicHelper.updateAcrylicBrush();
-        update();
+        repaintBackground();
         Q_EMIT tintColorChanged();
     }
 }
@@ -109,8 +556,7 @@ void QtAcrylicItem::setTintOpacity(const qreal value)
 {
     if (m_acrylicHelper.getTintOpacity() != value) {
         m_acrylicHelper.setTintOpacity(value);
-        m_acrylicHelper.updateAcrylicBrush();
-        update();
+        repaintBackground();
         Q_EMIT tintOpacityChanged();
     }
 }
@@ -124,8 +570,106 @@ void QtAcrylicItem::setNoiseOpacity(const qreal value)
 {
     if (m_acrylicHelper.getNoiseOpacity() != value) {
         m_acrylicHelper.setNoiseOpacity(value);
-        m_acrylicHelper.updateAcrylicBrush();
-        update();
+        repaintBackground();
         Q_EMIT noiseOpacityChanged();
     }
 }
+
+int QtAcrylicItem::noiseTileSize() const
+{
+    return m_acrylicHelper.getNoiseTileSize();
+}
+
+void QtAcrylicItem::setNoiseTileSize(const int value)
+{
+    if (value <= 0) {
+        qWarning() << "Noise tile size not valid.";
+        return;
+    }
+    // The helper clamps the value.
+    const int oldValue = m_acrylicHelper.getNoiseTileSize();
+    m_acrylicHelper.setNoiseTileSize(value);
+    if (m_acrylicHelper.getNoiseTileSize() != oldValue) {
+        repaintBackground();
+        Q_EMIT noiseTileSizeChanged();
+    }
+}
+
+qreal QtAcrylicItem::noiseIntensity() const
+{
+    return m_acrylicHelper.getNoiseIntensity();
+}
+
+void QtAcrylicItem::setNoiseIntensity(const qreal value)
+{
+    if ((value < 0) || (value > 1)) {
+        qWarning() << "Noise intensity not valid.";
+        return;
+    }
+    if (m_acrylicHelper.getNoiseIntensity() != value) {
+        m_acrylicHelper.setNoiseIntensity(value);
+        repaintBackground();
+        Q_EMIT noiseIntensityChanged();
+    }
+}
+
+bool QtAcrylicItem::fluentMaterial() const
+{
+    return (m_acrylicHelper.getMaterialMode() == QtAcrylicEffectHelper::MaterialMode::Fluent);
+}
+
+void QtAcrylicItem::setFluentMaterial(const bool value)
+{
+    if (fluentMaterial() != value) {
+        m_acrylicHelper.setMaterialMode(value ? QtAcrylicEffectHelper::MaterialMode::Fluent
+                                              : QtAcrylicEffectHelper::MaterialMode::Default);
+        repaintBackground();
+        Q_EMIT fluentMaterialChanged();
+    }
+}
+
+qreal QtAcrylicItem::luminosityOpacity() const
+{
+    return m_acrylicHelper.getLuminosityOpacity();
+}
+
+void QtAcrylicItem::setLuminosityOpacity(const qreal value)
+{
+    if (m_acrylicHelper.getLuminosityOpacity() != value) {
+        m_acrylicHelper.setLuminosityOpacity(value);
+        repaintBackground();
+        Q_EMIT luminosityOpacityChanged();
+    }
+}
+
+bool QtAcrylicItem::backdropCacheEnabled() const
+{
+    return m_acrylicHelper.isBackdropCacheEnabled();
+}
+
+void QtAcrylicItem::setBackdropCacheEnabled(const bool value)
+{
+    if (m_acrylicHelper.isBackdropCacheEnabled() != value) {
+        m_acrylicHelper.setBackdropCacheEnabled(value);
+        repaintBackground();
+        Q_EMIT backdropCacheEnabledChanged();
+    }
+}
+
+int QtAcrylicItem::cornerRadius() const
+{
+    return m_acrylicHelper.getCornerRadius();
+}
+
+void QtAcrylicItem::setCornerRadius(const int value)
+{
+    if (value < 0) {
+        qWarning() << "Corner radius not valid.";
+        return;
+    }
+    if (m_acrylicHelper.getCornerRadius() != value) {
+        m_acrylicHelper.setCornerRadius(value);
+        repaintBackground();
+        Q_EMIT cornerRadiusChanged();
+    }
+}
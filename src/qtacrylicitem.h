@@ -25,10 +25,14 @@
 #pragma once
 
 #include "qtacrylichelper_global.h"
-#include <QtQuick/qquickpainteditem.h>
+#include <QtQuick/qquickitem.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qvector.h>
 #include "qtacryliceffecthelper.h"
 
-class QTACRYLICHELPER_API QtAcrylicItem : public QQuickPaintedItem
+class QtAcrylicWindowTracker;
+
+class QTACRYLICHELPER_API QtAcrylicItem : public QQuickItem
 {
     Q_OBJECT
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
@@ -38,13 +42,17 @@ class QTACRYLICHELPER_API QtAcrylicItem : public QQuickPaintedItem
     Q_PROPERTY(QColor tintColor READ tintColor WRITE setTintColor NOTIFY tintColorChanged)
     Q_PROPERTY(qreal tintOpacity READ tintOpacity WRITE setTintOpacity NOTIFY tintOpacityChanged)
     Q_PROPERTY(qreal noiseOpacity READ noiseOpacity WRITE setNoiseOpacity NOTIFY noiseOpacityChanged)
+    Q_PROPERTY(int noiseTileSize READ noiseTileSize WRITE setNoiseTileSize NOTIFY noiseTileSizeChanged)
+    Q_PROPERTY(qreal noiseIntensity READ noiseIntensity WRITE setNoiseIntensity NOTIFY noiseIntensityChanged)
+    Q_PROPERTY(bool fluentMaterial READ fluentMaterial WRITE setFluentMaterial NOTIFY fluentMaterialChanged)
+    Q_PROPERTY(qreal luminosityOpacity READ luminosityOpacity WRITE setLuminosityOpacity NOTIFY luminosityOpacityChanged)
+    Q_PROPERTY(bool backdropCacheEnabled READ backdropCacheEnabled WRITE setBackdropCacheEnabled NOTIFY backdropCacheEnabledChanged)
+    Q_PROPERTY(int cornerRadius READ cornerRadius WRITE setCornerRadius NOTIFY cornerRadiusChanged)
 
 public:
     explicit QtAcrylicItem(QQuickItem *parent = nullptr);
     ~QtAcrylicItem() override;
 
-    void paint(QPainter *painter) override;
-
     QColor tintColor() const;
     void setTintColor(const QColor &value);
 
@@ -54,13 +62,56 @@ public:
     qreal noiseOpacity() const;
     void setNoiseOpacity(const qreal value);
 
+    int noiseTileSize() const;
+    void setNoiseTileSize(const int value);
+
+    qreal noiseIntensity() const;
+    void setNoiseIntensity(const qreal value);
+
+    bool fluentMaterial() const;
+    void setFluentMaterial(const bool value);
+
+    qreal luminosityOpacity() const;
+    void setLuminosityOpacity(const qreal value);
+
+    bool backdropCacheEnabled() const;
+    void setBackdropCacheEnabled(const bool value);
+
+    int cornerRadius() const;
+    void setCornerRadius(const int value);
+
 Q_SIGNALS:
     void tintColorChanged();
     void tintOpacityChanged();
     void noiseOpacityChanged();
+    void noiseTileSizeChanged();
+    void noiseIntensityChanged();
+    void fluentMaterialChanged();
+    void luminosityOpacityChanged();
+    void backdropCacheEnabledChanged();
+    void cornerRadiusChanged();
+
+protected:
+    void updatePolish() override;
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+
+private:
+    void positionChanged();
+    void watchAncestors();
+    void repaintBackground();
+    void scheduleUpdate();
 
 private:
     QtAcrylicEffectHelper m_acrylicHelper;
-    QMetaObject::Connection m_xConnection = {};
-    QMetaObject::Connection m_yConnection = {};
+    QPointer<QtAcrylicWindowTracker> m_windowTracker;
+    QVector<QMetaObject::Connection> m_ancestorConnections = {};
+    // ~QQuickItem() still emits these once the members are gone.
+    QMetaObject::Connection m_parentConnection = {};
+    QMetaObject::Connection m_windowConnection = {};
+    // Prepared on the GUI thread by updatePolish(), used by updatePaintNode().
+    bool m_compositeLayers = false;
+    QtAcrylicEffectHelper::Layers m_layers = {};
+    QImage m_rasterImage = {};
+    QPoint m_globalPosition = {};
+    qint64 m_nodeUpdateCost = 0;
 };
@@ -0,0 +1,229 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "qtacrylicqualitygovernor.h"
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qmath.h>
+
+// Weight of the newest sample in the moving average.
+static constexpr qreal kSmoothingFactor = 0.2;
+// Number of consecutive samples that must agree before the tier changes, stepping
+// up is much slower than stepping down to avoid oscillating between two tiers.
+static constexpr int kStepDownSamples = 8;
+static constexpr int kStepUpSamples = 120;
+// Stepping up is only considered when the cost is below this part of the budget.
+static constexpr qreal kHeadroomRatio = 0.5;
+
+Q_GLOBAL_STATIC(QtAcrylicQualityGovernor, governorInstance)
+
+QtAcrylicQualityGovernor::QtAcrylicQualityGovernor(QObject *parent) : QObject(parent)
+{
+}
+
+QtAcrylicQualityGovernor::~QtAcrylicQualityGovernor() = default;
+
+QtAcrylicQualityGovernor *QtAcrylicQualityGovernor::instance()
+{
+    return governorInstance();
+}
+
+QtAcrylicQualityGovernor::Tier QtAcrylicQualityGovernor::tier() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_hasForcedTier) {
+        return m_forcedTier;
+    }
+    return (m_enabled ? m_tier : Tier::Full);
+}
+
+void QtAcrylicQualityGovernor::setForcedTier(const Tier value)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_hasForcedTier && (m_forcedTier == value)) {
+            return;
+        }
+        m_forcedTier = value;
+        m_hasForcedTier = true;
+    }
+    Q_EMIT tierChanged();
+}
+
+void QtAcrylicQualityGovernor::clearForcedTier()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_hasForcedTier) {
+            return;
+        }
+        m_hasForcedTier = false;
+    }
+    Q_EMIT tierChanged();
+}
+
+bool QtAcrylicQualityGovernor::hasForcedTier() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hasForcedTier;
+}
+
+bool QtAcrylicQualityGovernor::isEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_enabled;
+}
+
+void QtAcrylicQualityGovernor::setEnabled(const bool value)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_enabled == value) {
+            return;
+        }
+        m_enabled = value;
+    }
+    Q_EMIT enabledChanged();
+    Q_EMIT tierChanged();
+}
+
+qreal QtAcrylicQualityGovernor::targetBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_targetBudget;
+}
+
+void QtAcrylicQualityGovernor::setTargetBudget(const qreal value)
+{
+    Q_ASSERT(value > 0);
+    if (value <= 0) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (qFuzzyCompare(m_targetBudget, value)) {
+            return;
+        }
+        m_targetBudget = value;
+        m_samplesOverBudget = 0;
+        m_samplesWithHeadroom = 0;
+    }
+    Q_EMIT targetBudgetChanged();
+}
+
+qreal QtAcrylicQualityGovernor::averagePaintCost() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_averagePaintCost;
+}
+
+qreal QtAcrylicQualityGovernor::wallpaperGenerationCost() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_wallpaperGenerationCost;
+}
+
+void QtAcrylicQualityGovernor::reportPaintCost(const qint64 nsecs)
+{
+    bool startFrame = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_frameCost += nsecs;
+        startFrame = !m_frameOpen;
+        m_frameOpen = true;
+    }
+    if (startFrame) {
+        // All the surfaces painted by the current repaint of the windows report
+        // before the event loop comes back here, they make up one frame.
+        QMetaObject::invokeMethod(this, [this](){
+            finishFrame();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void QtAcrylicQualityGovernor::finishFrame()
+{
+    Tier newTier = Tier::Full;
+    {
+        QMutexLocker locker(&m_mutex);
+        const qreal cost = qreal(m_frameCost) / qreal(1000000);
+        m_frameCost = 0;
+        m_frameOpen = false;
+        if (m_averagePaintCost <= 0) {
+            m_averagePaintCost = cost;
+        } else {
+            m_averagePaintCost += (cost - m_averagePaintCost) * kSmoothingFactor;
+        }
+        if (m_averagePaintCost > m_targetBudget) {
+            ++m_samplesOverBudget;
+            m_samplesWithHeadroom = 0;
+        } else if (m_averagePaintCost < (m_targetBudget * kHeadroomRatio)) {
+            ++m_samplesWithHeadroom;
+            m_samplesOverBudget = 0;
+        } else {
+            m_samplesOverBudget = 0;
+            m_samplesWithHeadroom = 0;
+        }
+        if (!m_enabled || m_hasForcedTier) {
+            return;
+        }
+        newTier = m_tier;
+        // Stepping up regenerates the wallpaper at a higher resolution, wait until
+        // the headroom has paid for it as well.
+        const int stepUpSamples = kStepUpSamples + qCeil(m_wallpaperGenerationCost / (m_targetBudget * kHeadroomRatio));
+        if ((m_samplesOverBudget >= kStepDownSamples) && (m_tier != Tier::SolidColor)) {
+            newTier = static_cast<Tier>(int(m_tier) + 1);
+        } else if ((m_samplesWithHeadroom >= stepUpSamples) && (m_tier != Tier::Full)) {
+            newTier = static_cast<Tier>(int(m_tier) - 1);
+        }
+        if (newTier == m_tier) {
+            return;
+        }
+    }
+    setTier(newTier);
+}
+
+void QtAcrylicQualityGovernor::reportWallpaperGenerationCost(const qint64 nsecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_wallpaperGenerationCost = qreal(nsecs) / qreal(1000000);
+}
+
+void QtAcrylicQualityGovernor::setTier(const Tier value)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_tier == value) {
+            return;
+        }
+        m_tier = value;
+        m_samplesOverBudget = 0;
+        m_samplesWithHeadroom = 0;
+        // The average was measured with the previous tier, start over.
+        m_averagePaintCost = 0;
+    }
+    // Paints may happen on the render thread of Qt Quick, always notify from
+    // the thread this object lives in.
+    QMetaObject::invokeMethod(this, "tierChanged", Qt::AutoConnection);
+}
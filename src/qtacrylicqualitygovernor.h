@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qmutex.h>
+
+class QTACRYLICHELPER_API QtAcrylicQualityGovernor : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QtAcrylicQualityGovernor)
+    Q_PROPERTY(Tier tier READ tier NOTIFY tierChanged)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(qreal targetBudget READ targetBudget WRITE setTargetBudget NOTIFY targetBudgetChanged)
+    Q_PROPERTY(qreal averagePaintCost READ averagePaintCost)
+    Q_PROPERTY(qreal wallpaperGenerationCost READ wallpaperGenerationCost)
+
+public:
+    // Ordered from the best looking to the cheapest one.
+    enum class Tier
+    {
+        Full,
+        ReducedResolution, // Half resolution backdrop.
+        NoNoise, // Same as above, without the noise layer.
+        SolidColor // No backdrop at all, an opaque color only.
+    };
+    Q_ENUM(Tier)
+
+    explicit QtAcrylicQualityGovernor(QObject *parent = nullptr);
+    ~QtAcrylicQualityGovernor() override;
+
+    static QtAcrylicQualityGovernor *instance();
+
+    Tier tier() const;
+
+    // Pins the tier, the measurements are still collected but don't change
+    // anything until the override is cleared.
+    void setForcedTier(const Tier value);
+    void clearForcedTier();
+    bool hasForcedTier() const;
+
+    bool isEnabled() const;
+    void setEnabled(const bool value);
+
+    // In milliseconds, per frame: the paint cost of all the acrylic surfaces
+    // repainted together is compared to it.
+    qreal targetBudget() const;
+    void setTargetBudget(const qreal value);
+
+    // In milliseconds.
+    qreal averagePaintCost() const;
+    qreal wallpaperGenerationCost() const;
+
+    // Both can be called from the render thread of Qt Quick. The paint costs are
+    // summed until the event loop of the governor's thread runs again.
+    void reportPaintCost(const qint64 nsecs);
+    void reportWallpaperGenerationCost(const qint64 nsecs);
+
+Q_SIGNALS:
+    void tierChanged();
+    void enabledChanged();
+    void targetBudgetChanged();
+
+private:
+    void finishFrame();
+    void setTier(const Tier value);
+
+private:
+    mutable QMutex m_mutex;
+    Tier m_tier = Tier::Full;
+    Tier m_forcedTier = Tier::Full;
+    bool m_hasForcedTier = false;
+    bool m_enabled = true;
+    qreal m_targetBudget = 4.0;
+    qreal m_averagePaintCost = 0.0;
+    qreal m_wallpaperGenerationCost = 0.0;
+    qint64 m_frameCost = 0;
+    bool m_frameOpen = false;
+    int m_samplesOverBudget = 0;
+    int m_samplesWithHeadroom = 0;
+};
@@ -0,0 +1,136 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "qtacrylicrepaintscheduler.h"
+#include <QtCore/qcoreevent.h>
+#include <QtGui/qwindow.h>
+#include <atomic>
+
+static std::atomic_int g_maximumFrameRate{0};
+
+QtAcrylicRepaintScheduler::QtAcrylicRepaintScheduler(QWindow *window) : QObject(window), m_window(window)
+{
+    Q_ASSERT(m_window);
+    m_throttleTimer.setSingleShot(true);
+    m_throttleTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_throttleTimer, &QTimer::timeout, this, [this](){
+        if (m_window) {
+            m_window->requestUpdate();
+        }
+    });
+    m_window->installEventFilter(this);
+}
+
+QtAcrylicRepaintScheduler::~QtAcrylicRepaintScheduler() = default;
+
+QtAcrylicRepaintScheduler *QtAcrylicRepaintScheduler::get(QWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return nullptr;
+    }
+    auto scheduler = window->findChild<QtAcrylicRepaintScheduler *>(QString{}, Qt::FindDirectChildrenOnly);
+    if (!scheduler) {
+        // Owned by the window, it goes away together with it.
+        scheduler = new QtAcrylicRepaintScheduler(window);
+    }
+    return scheduler;
+}
+
+void QtAcrylicRepaintScheduler::schedule(QWindow *window, QObject *surface, const std::function<void()> &callback)
+{
+    Q_ASSERT(surface);
+    Q_ASSERT(callback);
+    if (!surface || !callback) {
+        return;
+    }
+    if (!window) {
+        callback();
+        return;
+    }
+    get(window)->add(surface, callback);
+}
+
+void QtAcrylicRepaintScheduler::setMaximumFrameRate(const int value)
+{
+    g_maximumFrameRate.store(qMax(0, value), std::memory_order_relaxed);
+}
+
+int QtAcrylicRepaintScheduler::maximumFrameRate()
+{
+    return g_maximumFrameRate.load(std::memory_order_relaxed);
+}
+
+bool QtAcrylicRepaintScheduler::eventFilter(QObject *object, QEvent *event)
+{
+    // Only observe the update request, the window still needs to handle it.
+    if ((object == m_window) && (event->type() == QEvent::UpdateRequest) && m_frameRequested) {
+        flush();
+    }
+    return QObject::eventFilter(object, event);
+}
+
+void QtAcrylicRepaintScheduler::add(QObject *surface, const std::function<void()> &callback)
+{
+    if (!m_surfaces.contains(surface)) {
+        m_surfaces.insert(surface);
+        connect(surface, &QObject::destroyed, this, [this](QObject *object){
+            m_surfaces.remove(object);
+            m_pending.remove(object);
+        });
+    }
+    m_pending.insert(surface, callback);
+    requestFrame();
+}
+
+void QtAcrylicRepaintScheduler::requestFrame()
+{
+    if (m_frameRequested) {
+        return;
+    }
+    m_frameRequested = true;
+    const int frameRate = maximumFrameRate();
+    if ((frameRate > 0) && m_lastFlush.isValid()) {
+        const qint64 interval = 1000 / frameRate;
+        const qint64 elapsed = m_lastFlush.elapsed();
+        if (elapsed < interval) {
+            m_throttleTimer.start(int(interval - elapsed));
+            return;
+        }
+    }
+    m_window->requestUpdate();
+}
+
+void QtAcrylicRepaintScheduler::flush()
+{
+    m_frameRequested = false;
+    m_lastFlush.start();
+    // The callbacks may schedule new repaints, they belong to the next frame.
+    const QHash<QObject *, std::function<void()>> pending = std::move(m_pending);
+    m_pending.clear();
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        it.value()();
+    }
+}
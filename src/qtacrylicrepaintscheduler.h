@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qset.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qtimer.h>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QWindow)
+QT_END_NAMESPACE
+
+// Coalesces the repaint requests of the acrylic surfaces of one window and
+// delivers them in step with the window's frame updates, so that a flood of
+// move events results in at most one repaint per surface per frame.
+class QTACRYLICHELPER_API QtAcrylicRepaintScheduler : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QtAcrylicRepaintScheduler)
+
+public:
+    explicit QtAcrylicRepaintScheduler(QWindow *window);
+    ~QtAcrylicRepaintScheduler() override;
+
+    static QtAcrylicRepaintScheduler *get(QWindow *window);
+
+    // Runs "callback" once before the next frame of "window". Scheduling the same
+    // surface several times before that only keeps the latest callback. Without
+    // a window the callback runs immediately.
+    static void schedule(QWindow *window, QObject *surface, const std::function<void()> &callback);
+
+    // Upper limit of the flushes per second, per window. Zero means no limit
+    // other than the pace of the window's frame updates.
+    static void setMaximumFrameRate(const int value);
+    static int maximumFrameRate();
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    void add(QObject *surface, const std::function<void()> &callback);
+    void requestFrame();
+    void flush();
+
+private:
+    QWindow *m_window = nullptr;
+    QSet<QObject *> m_surfaces = {};
+    QHash<QObject *, std::function<void()>> m_pending = {};
+    QElapsedTimer m_lastFlush;
+    QTimer m_throttleTimer;
+    bool m_frameRequested = false;
+};
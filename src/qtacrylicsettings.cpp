@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "qtacrylicsettings.h"
+#include <QtCore/qdebug.h>
+#include "qtacrylicrepaintscheduler.h"
+
+Q_GLOBAL_STATIC(QtAcrylicSettings, settingsInstance)
+
+QtAcrylicSettings::QtAcrylicSettings(QObject *parent) : QObject(parent)
+{
+}
+
+QtAcrylicSettings::~QtAcrylicSettings() = default;
+
+QtAcrylicSettings *QtAcrylicSettings::instance()
+{
+    return settingsInstance();
+}
+
+qreal QtAcrylicSettings::blurRadius() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_blurRadius;
+}
+
+void QtAcrylicSettings::setBlurRadius(const qreal value)
+{
+    if (value < 0) {
+        qWarning() << value << "is not a valid blur radius.";
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (qFuzzyCompare(m_blurRadius, value)) {
+            return;
+        }
+        m_blurRadius = value;
+    }
+    Q_EMIT blurRadiusChanged();
+    Q_EMIT settingsChanged();
+}
+
+int QtAcrylicSettings::backdropDownsampleFactor() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_backdropDownsampleFactor;
+}
+
+void QtAcrylicSettings::setBackdropDownsampleFactor(const int value)
+{
+    if (value < 1) {
+        qWarning() << value << "is not a valid downsample factor.";
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_backdropDownsampleFactor == value) {
+            return;
+        }
+        m_backdropDownsampleFactor = value;
+    }
+    Q_EMIT backdropDownsampleFactorChanged();
+    Q_EMIT settingsChanged();
+}
+
+bool QtAcrylicSettings::isNoiseEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_noiseEnabled;
+}
+
+void QtAcrylicSettings::setNoiseEnabled(const bool value)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_noiseEnabled == value) {
+            return;
+        }
+        m_noiseEnabled = value;
+    }
+    Q_EMIT noiseEnabledChanged();
+    Q_EMIT settingsChanged();
+}
+
+int QtAcrylicSettings::maximumRepaintRate() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maximumRepaintRate;
+}
+
+void QtAcrylicSettings::setMaximumRepaintRate(const int value)
+{
+    if (value < 0) {
+        qWarning() << value << "is not a valid repaint rate.";
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_maximumRepaintRate == value) {
+            return;
+        }
+        m_maximumRepaintRate = value;
+    }
+    QtAcrylicRepaintScheduler::setMaximumFrameRate(value);
+    Q_EMIT maximumRepaintRateChanged();
+    Q_EMIT settingsChanged();
+}
+
+int QtAcrylicSettings::cacheMemoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cacheMemoryBudget;
+}
+
+void QtAcrylicSettings::setCacheMemoryBudget(const int value)
+{
+    if (value < 0) {
+        qWarning() << value << "is not a valid cache memory budget.";
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_cacheMemoryBudget == value) {
+            return;
+        }
+        m_cacheMemoryBudget = value;
+    }
+    Q_EMIT cacheMemoryBudgetChanged();
+    Q_EMIT settingsChanged();
+}
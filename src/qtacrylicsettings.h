@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qmutex.h>
+
+// Application wide knobs, they can be changed at any time (from QML too, when
+// registered as a singleton) and only invalidate the caches they affect.
+class QTACRYLICHELPER_API QtAcrylicSettings : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QtAcrylicSettings)
+    Q_PROPERTY(qreal blurRadius READ blurRadius WRITE setBlurRadius NOTIFY blurRadiusChanged)
+    Q_PROPERTY(int backdropDownsampleFactor READ backdropDownsampleFactor WRITE setBackdropDownsampleFactor NOTIFY backdropDownsampleFactorChanged)
+    Q_PROPERTY(bool noiseEnabled READ isNoiseEnabled WRITE setNoiseEnabled NOTIFY noiseEnabledChanged)
+    Q_PROPERTY(int maximumRepaintRate READ maximumRepaintRate WRITE setMaximumRepaintRate NOTIFY maximumRepaintRateChanged)
+    Q_PROPERTY(int cacheMemoryBudget READ cacheMemoryBudget WRITE setCacheMemoryBudget NOTIFY cacheMemoryBudgetChanged)
+
+public:
+    explicit QtAcrylicSettings(QObject *parent = nullptr);
+    ~QtAcrylicSettings() override;
+
+    static QtAcrylicSettings *instance();
+
+    // In device independent pixels. Changing it regenerates the blured wallpaper.
+    qreal blurRadius() const;
+    void setBlurRadius(const qreal value);
+
+    // The blured wallpaper is generated at 1/factor of the screen resolution and
+    // stretched when painted. The blur hides most of the difference.
+    int backdropDownsampleFactor() const;
+    void setBackdropDownsampleFactor(const int value);
+
+    bool isNoiseEnabled() const;
+    void setNoiseEnabled(const bool value);
+
+    // In frames per second, 0 means no limit other than the display refresh rate.
+    int maximumRepaintRate() const;
+    void setMaximumRepaintRate(const int value);
+
+    // In MiB, for all the caches shared by the acrylic surfaces. The wallpaper being
+    // painted is always kept, the precomposed backdrops get what is left.
+    int cacheMemoryBudget() const;
+    void setCacheMemoryBudget(const int value);
+
+Q_SIGNALS:
+    void blurRadiusChanged();
+    void backdropDownsampleFactorChanged();
+    void noiseEnabledChanged();
+    void maximumRepaintRateChanged();
+    void cacheMemoryBudgetChanged();
+    // Emitted after any of the above, the acrylic surfaces repaint on it.
+    void settingsChanged();
+
+private:
+    mutable QMutex m_mutex;
+    qreal m_blurRadius = 128.0;
+    int m_backdropDownsampleFactor = 1;
+    bool m_noiseEnabled = true;
+    int m_maximumRepaintRate = 0;
+    int m_cacheMemoryBudget = 128;
+};
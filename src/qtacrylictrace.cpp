@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qtacrylictrace.h"
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+#include <atomic>
+
+static constexpr int kTraceCapacity = 4096;
+
+static std::atomic_bool g_traceEnabled = {qEnvironmentVariableIsSet(_qam::Global::_qam_trace_flag)};
+
+struct QtAcrylicTraceData
+{
+    QMutex mutex;
+    QElapsedTimer clock;
+    QVector<QtAcrylicTrace::Record> records;
+    int next = 0; // Where the next record goes once the buffer is full.
+};
+
+Q_GLOBAL_STATIC(QtAcrylicTraceData, traceData)
+
+// Only called with the mutex locked.
+static inline qint64 traceClock(QtAcrylicTraceData *data)
+{
+    if (!data->clock.isValid()) {
+        data->clock.start();
+    }
+    return data->clock.nsecsElapsed();
+}
+
+bool QtAcrylicTrace::isEnabled()
+{
+    return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+void QtAcrylicTrace::setEnabled(const bool value)
+{
+    g_traceEnabled.store(value, std::memory_order_relaxed);
+}
+
+QVector<QtAcrylicTrace::Record> QtAcrylicTrace::records()
+{
+    QtAcrylicTraceData *data = traceData();
+    QMutexLocker locker(&data->mutex);
+    if (data->records.size() < kTraceCapacity) {
+        return data->records;
+    }
+    QVector<Record> result = {};
+    result.reserve(kTraceCapacity);
+    for (int i = 0; i != kTraceCapacity; ++i) {
+        result.append(data->records.at((data->next + i) % kTraceCapacity));
+    }
+    return result;
+}
+
+void QtAcrylicTrace::clear()
+{
+    QtAcrylicTraceData *data = traceData();
+    QMutexLocker locker(&data->mutex);
+    data->records.clear();
+    data->next = 0;
+}
+
+const char *QtAcrylicTrace::stageName(const Stage stage)
+{
+    switch (stage) {
+    case Stage::PaintBackground:
+        return "paintBackground";
+    case Stage::UpdateBrush:
+        return "updateBrush";
+    case Stage::GenerateWallpaper:
+        return "generateWallpaper";
+    case Stage::ComposeBackdrop:
+        return "composeBackdrop";
+    case Stage::HalfScale:
+        return "halfScale";
+    case Stage::Blur:
+        return "blur";
+    case Stage::DrawBlur:
+        return "drawBlur";
+    }
+    return "unknown";
+}
+
+QtAcrylicTraceScope::QtAcrylicTraceScope(const QtAcrylicTrace::Stage stage, const void *surface, const QSize &size)
+{
+    if (!QtAcrylicTrace::isEnabled()) {
+        return;
+    }
+    QtAcrylicTraceData *data = traceData();
+    m_active = true;
+    m_record.stage = stage;
+    m_record.surface = surface;
+    m_record.size = size;
+    QMutexLocker locker(&data->mutex);
+    m_record.start = traceClock(data);
+}
+
+QtAcrylicTraceScope::~QtAcrylicTraceScope()
+{
+    if (!m_active || traceData.isDestroyed()) {
+        return;
+    }
+    QtAcrylicTraceData *data = traceData();
+    QMutexLocker locker(&data->mutex);
+    m_record.duration = traceClock(data) - m_record.start;
+    if (data->records.size() < kTraceCapacity) {
+        data->records.append(m_record);
+    } else {
+        data->records[data->next] = m_record;
+        data->next = (data->next + 1) % kTraceCapacity;
+    }
+}
+
+void QtAcrylicTraceScope::setCacheHit(const bool value)
+{
+    m_record.cacheHit = value;
+}
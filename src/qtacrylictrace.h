@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <QtCore/qsize.h>
+#include <QtCore/qvector.h>
+
+// A lightweight in-process trace of the expensive acrylic stages, to find out
+// where the time goes when a user reports jank. Disabled, a trace point costs one
+// relaxed atomic load. Enabled (setEnabled() or the environment variable in
+// qtacrylichelper_global.h), the records go into a fixed size ring buffer that
+// can be read back at any time, from any thread.
+class QTACRYLICHELPER_API QtAcrylicTrace
+{
+    Q_DISABLE_COPY_MOVE(QtAcrylicTrace)
+
+public:
+    enum class Stage : quint8
+    {
+        PaintBackground,
+        UpdateBrush,
+        GenerateWallpaper,
+        ComposeBackdrop,
+        HalfScale,
+        Blur,
+        DrawBlur
+    };
+
+    struct Record
+    {
+        Stage stage = Stage::PaintBackground;
+        const void *surface = nullptr; // The helper of the surface, if any.
+        QSize size = {};
+        bool cacheHit = false;
+        qint64 start = 0; // In nanoseconds, relative to the first enabled trace point.
+        qint64 duration = 0; // In nanoseconds.
+    };
+
+    static bool isEnabled();
+    static void setEnabled(const bool value);
+
+    // Oldest first, at most the last 4096 records.
+    static QVector<Record> records();
+    static void clear();
+
+    static const char *stageName(const Stage stage);
+};
+
+// Records the lifetime of the scope as one stage. Nothing happens if tracing is
+// disabled when the scope starts.
+class QTACRYLICHELPER_API QtAcrylicTraceScope
+{
+    Q_DISABLE_COPY_MOVE(QtAcrylicTraceScope)
+
+public:
+    explicit QtAcrylicTraceScope(const QtAcrylicTrace::Stage stage, const void *surface = nullptr, const QSize &size = {});
+    ~QtAcrylicTraceScope();
+
+    void setCacheHit(const bool value);
+
+private:
+    QtAcrylicTrace::Record m_record = {};
+    bool m_active = false;
+};
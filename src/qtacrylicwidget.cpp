@@ -24,11 +24,49 @@
 
 #include "qtacrylicwidget.h"
 #include <QtCore/qdebug.h>
+#include <QtCore/qhash.h>
 #include <QtGui/qpainter.h>
+#include <QtGui/qpaintengine.h>
+#include <QtGui/qbackingstore.h>
 #include "utilities.h"
+#include "qtacrylicqualitygovernor.h"
+#include "qtacrylicsettings.h"
+#include "qtacrylicwindowtracker.h"
+#include <algorithm>
 
 using namespace _qam;
 
+// Numbers the widgets of the window in the order they are painted: a widget before
+// its children, the children in their stacking order.
+static void indexPaintOrder(const QWidget *widget, QHash<const QObject *, int> &order)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    order.insert(widget, order.size());
+    for (const QObject *child : widget->children()) {
+        const auto childWidget = qobject_cast<const QWidget *>(child);
+        // Native windows inside this one have their own tracker.
+        if (childWidget && !childWidget->isWindow()) {
+            indexPaintOrder(childWidget, order);
+        }
+    }
+}
+
+// Whether the painter draws into the backing store of the window, as opposed to
+// QWidget::grab() or QWidget::render(), which only paint a part of the widgets.
+static inline bool isBackingStorePaint(const QWidget *widget, const QPainter &painter)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return false;
+    }
+    const QBackingStore *backingStore = widget->window()->backingStore();
+    const QPaintEngine *engine = painter.paintEngine();
+    return (backingStore && engine && (engine->paintDevice() == backingStore->paintDevice()));
+}
+
 QtAcrylicWidget::QtAcrylicWidget(QWidget *parent) : QWidget(parent)
 {
     setAutoFillBackground(false);
@@ -36,6 +74,14 @@ QtAcrylicWidget::QtAcrylicWidget(QWidget *parent) : QWidget(parent)
     setBackgroundRole(QPalette::Base);
     m_acrylicHelper.showPerformanceWarning();
     m_acrylicHelper.updateAcrylicBrush();
+    connect(QtAcrylicQualityGovernor::instance(), &QtAcrylicQualityGovernor::tierChanged, this, [this](){
+        updateOpaquePaintEvent();
+        update();
+    });
+    connect(QtAcrylicSettings::instance(), &QtAcrylicSettings::settingsChanged, this, [this](){
+        update();
+    });
+    watchAncestors();
 }
 
 QtAcrylicWidget::~QtAcrylicWidget() = default;
@@ -76,7 +122,6 @@ void QtAcrylicWidget::setTintOpacity(const qreal value)
 {
     if (m_acrylicHelper.getTintOpacity() != value) {
         m_acrylicHelper.setTintOpacity(value);
-        m_acrylicHelper.updateAcrylicBrush();
         update();
         Q_EMIT tintOpacityChanged();
     }
@@ -91,25 +136,245 @@ void QtAcrylicWidget::setNoiseOpacity(const qreal value)
 {
     if (m_acrylicHelper.getNoiseOpacity() != value) {
         m_acrylicHelper.setNoiseOpacity(value);
-        m_acrylicHelper.updateAcrylicBrush();
         update();
         Q_EMIT noiseOpacityChanged();
     }
 }
 
+int QtAcrylicWidget::noiseTileSize() const
+{
+    return m_acrylicHelper.getNoiseTileSize();
+}
+
+void QtAcrylicWidget::setNoiseTileSize(const int value)
+{
+    if (value <= 0) {
+        qWarning() << "Noise tile size not valid.";
+        return;
+    }
+    // The helper clamps the value.
+    const int oldValue = m_acrylicHelper.getNoiseTileSize();
+    m_acrylicHelper.setNoiseTileSize(value);
+    if (m_acrylicHelper.getNoiseTileSize() != oldValue) {
+        update();
+        Q_EMIT noiseTileSizeChanged();
+    }
+}
+
+qreal QtAcrylicWidget::noiseIntensity() const
+{
+    return m_acrylicHelper.getNoiseIntensity();
+}
+
+void QtAcrylicWidget::setNoiseIntensity(const qreal value)
+{
+    if ((value < 0) || (value > 1)) {
+        qWarning() << "Noise intensity not valid.";
+        return;
+    }
+    if (m_acrylicHelper.getNoiseIntensity() != value) {
+        m_acrylicHelper.setNoiseIntensity(value);
+        update();
+        Q_EMIT noiseIntensityChanged();
+    }
+}
+
+bool QtAcrylicWidget::fluentMaterial() const
+{
+    return (m_acrylicHelper.getMaterialMode() == QtAcrylicEffectHelper::MaterialMode::Fluent);
+}
+
+void QtAcrylicWidget::setFluentMaterial(const bool value)
+{
+    if (fluentMaterial() != value) {
+        m_acrylicHelper.setMaterialMode(value ? QtAcrylicEffectHelper::MaterialMode::Fluent
+                                              : QtAcrylicEffectHelper::MaterialMode::Default);
+        update();
+        Q_EMIT fluentMaterialChanged();
+    }
+}
+
+qreal QtAcrylicWidget::luminosityOpacity() const
+{
+    return m_acrylicHelper.getLuminosityOpacity();
+}
+
+void QtAcrylicWidget::setLuminosityOpacity(const qreal value)
+{
+    if (m_acrylicHelper.getLuminosityOpacity() != value) {
+        m_acrylicHelper.setLuminosityOpacity(value);
+        update();
+        Q_EMIT luminosityOpacityChanged();
+    }
+}
+
+bool QtAcrylicWidget::backdropCacheEnabled() const
+{
+    return m_acrylicHelper.isBackdropCacheEnabled();
+}
+
+void QtAcrylicWidget::setBackdropCacheEnabled(const bool value)
+{
+    if (m_acrylicHelper.isBackdropCacheEnabled() != value) {
+        m_acrylicHelper.setBackdropCacheEnabled(value);
+        update();
+        Q_EMIT backdropCacheEnabledChanged();
+    }
+}
+
+int QtAcrylicWidget::cornerRadius() const
+{
+    return m_acrylicHelper.getCornerRadius();
+}
+
+void QtAcrylicWidget::setCornerRadius(const int value)
+{
+    if (value < 0) {
+        qWarning() << "Corner radius not valid.";
+        return;
+    }
+    if (m_acrylicHelper.getCornerRadius() != value) {
+        m_acrylicHelper.setCornerRadius(value);
+        updateOpaquePaintEvent();
+        update();
+        Q_EMIT cornerRadiusChanged();
+    }
+}
+
+QtAcrylicWindowTracker *QtAcrylicWidget::windowTracker()
+{
+    QWindow *handle = window()->windowHandle();
+    if (m_windowTracker && (m_windowTracker->window() == handle)) {
+        return m_windowTracker;
+    }
+    if (m_windowTracker) {
+        m_windowTracker->unregisterSurface(this);
+    }
+    m_windowTracker = (handle ? QtAcrylicWindowTracker::get(handle) : nullptr);
+    if (m_windowTracker) {
+        m_windowTracker->registerSurface(this, [this](){
+            return mapTo(window(), QPoint{0, 0});
+        }, [this](){
+            update();
+        }, [this](){
+            return m_acrylicHelper.isWallpaperBlurActive();
+        });
+    }
+    return m_windowTracker;
+}
+
 void QtAcrylicWidget::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
-    const QRect rect = {mapToGlobal(QPoint{0, 0}), size()};
-    m_acrylicHelper.paintBackground(&painter, rect);
+    QtAcrylicWindowTracker *tracker = windowTracker();
+    const QPoint position = (tracker ? tracker->globalPosition(this) : mapToGlobal(QPoint{0, 0}));
+    const QRect rect = {position, size()};
+    // Qt already leaves out the rectangular opaque widgets above this one, but not
+    // the acrylic surfaces with rounded corners, nor the surfaces whose backdrop
+    // only turned out to be opaque after they were shown. They are only painted in
+    // the same pass when the whole window is.
+    QRegion damage = event->region();
+    if (tracker && isBackingStorePaint(this, painter)) {
+        damage -= tracker->occludedRegion(this, [](QObject *object, const QRegion &opaqueRegion){
+            const auto other = qobject_cast<QWidget *>(object);
+            if (!other || !other->isVisible()) {
+                return QRegion{};
+            }
+            return (opaqueRegion & other->visibleRegion());
+        }, [this](QVector<QObject *> &surfaces){
+            QHash<const QObject *, int> order = {};
+            indexPaintOrder(window(), order);
+            std::stable_sort(surfaces.begin(), surfaces.end(), [&order](const QObject *left, const QObject *right){
+                return (order.value(left, -1) < order.value(right, -1));
+            });
+        });
+    }
+    if (!damage.isEmpty()) {
+        m_acrylicHelper.paintBackground(&painter, rect, damage, devicePixelRatioF());
+    }
     QWidget::paintEvent(event);
+    // Whether the wallpaper could be read is only known after the first paint. The
+    // attribute changes which regions Qt computes for the repaint in progress, so
+    // it's only updated once the repaint is done.
+    if ((m_acrylicHelper.isOpaque() != testAttribute(Qt::WA_OpaquePaintEvent))
+            || (m_acrylicHelper.getOpaqueRegion(size()) != m_opaqueRegion)) {
+        QMetaObject::invokeMethod(this, &QtAcrylicWidget::updateOpaquePaintEvent, Qt::QueuedConnection);
+    }
+}
+
+void QtAcrylicWidget::updateOpaquePaintEvent()
+{
+    // When the backdrop covers every pixel, Qt doesn't need to paint the widgets
+    // below this one before each repaint.
+    const bool opaque = m_acrylicHelper.isOpaque();
+    if (testAttribute(Qt::WA_OpaquePaintEvent) != opaque) {
+        setAttribute(Qt::WA_OpaquePaintEvent, opaque);
+    }
+    // The other acrylic surfaces below this one skip what it covers.
+    m_opaqueRegion = m_acrylicHelper.getOpaqueRegion(size());
+    if (m_windowTracker) {
+        m_windowTracker->setOpaqueRegion(this, m_opaqueRegion);
+    }
+}
+
+void QtAcrylicWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    // Must be up to date before the surfaces below repaint what has been uncovered.
+    updateOpaquePaintEvent();
 }
 
 void QtAcrylicWidget::moveEvent(QMoveEvent *event)
 {
     QWidget::moveEvent(event);
-    if (Utilities::shouldUseWallpaperBlur()) {
-        update();
+    positionChanged();
+}
+
+bool QtAcrylicWidget::eventFilter(QObject *object, QEvent *event)
+{
+    // Only the ancestors are watched. Scrolling, splitters and layouts move them
+    // without moving this widget, yet it ends up somewhere else in the window.
+    switch (event->type()) {
+    case QEvent::Move:
+        positionChanged();
+        break;
+    case QEvent::ParentChange:
+        watchAncestors();
+        positionChanged();
+        break;
+    default:
+        break;
+    }
+    return QWidget::eventFilter(object, event);
+}
+
+void QtAcrylicWidget::positionChanged()
+{
+    QtAcrylicWindowTracker *tracker = windowTracker();
+    if (tracker) {
+        tracker->invalidateOffset(this);
+    }
+    if (m_acrylicHelper.isWallpaperBlurActive()) {
+        if (tracker) {
+            tracker->scheduleUpdate(this);
+        } else {
+            update();
+        }
+    }
+}
+
+void QtAcrylicWidget::watchAncestors()
+{
+    for (auto &&ancestor : qAsConst(m_watchedAncestors)) {
+        if (ancestor) {
+            ancestor->removeEventFilter(this);
+        }
+    }
+    m_watchedAncestors.clear();
+    // The top level window itself is left out, the window tracker watches it.
+    for (QWidget *ancestor = parentWidget(); ancestor && !ancestor->isWindow(); ancestor = ancestor->parentWidget()) {
+        ancestor->installEventFilter(this);
+        m_watchedAncestors.append(ancestor);
     }
 }
 
@@ -118,5 +383,10 @@ void QtAcrylicWidget::changeEvent(QEvent *event)
     QWidget::changeEvent(event);
     if (event->type() == QEvent::PaletteChange) {
         m_acrylicHelper.updateAcrylicBrush();
+    } else if (event->type() == QEvent::ParentChange) {
+        watchAncestors();
+        if (m_windowTracker) {
+            m_windowTracker->invalidateOffset(this);
+        }
     }
 }
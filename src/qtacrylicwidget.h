@@ -26,8 +26,12 @@
 
 #include "qtacrylichelper_global.h"
 #include <QtWidgets/qwidget.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qvector.h>
 #include "qtacryliceffecthelper.h"
 
+class QtAcrylicWindowTracker;
+
 class QTACRYLICHELPER_API QtAcrylicWidget : public QWidget
 {
     Q_OBJECT
@@ -35,6 +39,12 @@ class QTACRYLICHELPER_API QtAcrylicWidget : public QWidget
     Q_PROPERTY(QColor tintColor READ tintColor WRITE setTintColor NOTIFY tintColorChanged)
     Q_PROPERTY(qreal tintOpacity READ tintOpacity WRITE setTintOpacity NOTIFY tintOpacityChanged)
     Q_PROPERTY(qreal noiseOpacity READ noiseOpacity WRITE setNoiseOpacity NOTIFY noiseOpacityChanged)
+    Q_PROPERTY(int noiseTileSize READ noiseTileSize WRITE setNoiseTileSize NOTIFY noiseTileSizeChanged)
+    Q_PROPERTY(qreal noiseIntensity READ noiseIntensity WRITE setNoiseIntensity NOTIFY noiseIntensityChanged)
+    Q_PROPERTY(bool fluentMaterial READ fluentMaterial WRITE setFluentMaterial NOTIFY fluentMaterialChanged)
+    Q_PROPERTY(qreal luminosityOpacity READ luminosityOpacity WRITE setLuminosityOpacity NOTIFY luminosityOpacityChanged)
+    Q_PROPERTY(bool backdropCacheEnabled READ backdropCacheEnabled WRITE setBackdropCacheEnabled NOTIFY backdropCacheEnabledChanged)
+    Q_PROPERTY(int cornerRadius READ cornerRadius WRITE setCornerRadius NOTIFY cornerRadiusChanged)
 
 public:
     explicit QtAcrylicWidget(QWidget *parent = nullptr);
@@ -49,16 +59,51 @@ public:
     qreal noiseOpacity() const;
     void setNoiseOpacity(const qreal value);
 
+    int noiseTileSize() const;
+    void setNoiseTileSize(const int value);
+
+    qreal noiseIntensity() const;
+    void setNoiseIntensity(const qreal value);
+
+    bool fluentMaterial() const;
+    void setFluentMaterial(const bool value);
+
+    qreal luminosityOpacity() const;
+    void setLuminosityOpacity(const qreal value);
+
+    bool backdropCacheEnabled() const;
+    void setBackdropCacheEnabled(const bool value);
+
+    int cornerRadius() const;
+    void setCornerRadius(const int value);
+
 Q_SIGNALS:
     void tintColorChanged();
     void tintOpacityChanged();
     void noiseOpacityChanged();
+    void noiseTileSizeChanged();
+    void noiseIntensityChanged();
+    void fluentMaterialChanged();
+    void luminosityOpacityChanged();
+    void backdropCacheEnabledChanged();
+    void cornerRadiusChanged();
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void moveEvent(QMoveEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     void changeEvent(QEvent *event) override;
+    bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    QtAcrylicWindowTracker *windowTracker();
+    void updateOpaquePaintEvent();
+    void positionChanged();
+    void watchAncestors();
 
 private:
     QtAcrylicEffectHelper m_acrylicHelper;
+    QPointer<QtAcrylicWindowTracker> m_windowTracker;
+    QVector<QPointer<QWidget>> m_watchedAncestors = {};
+    QRegion m_opaqueRegion = {};
 };
@@ -0,0 +1,278 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "qtacrylicwindowtracker.h"
+#include "qtacrylicrepaintscheduler.h"
+#include "utilities.h"
+#include <QtCore/qcoreevent.h>
+#include <QtGui/qwindow.h>
+#include <QtGui/qevent.h>
+#include <algorithm>
+
+using namespace _qam;
+
+QtAcrylicWindowTracker::QtAcrylicWindowTracker(QWindow *window) : QObject(window), m_window(window)
+{
+    Q_ASSERT(m_window);
+    updateWindowPosition();
+    m_window->installEventFilter(this);
+    Utilities::registerWindow(m_window);
+}
+
+QtAcrylicWindowTracker::~QtAcrylicWindowTracker() = default;
+
+QtAcrylicWindowTracker *QtAcrylicWindowTracker::get(QWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return nullptr;
+    }
+    auto tracker = window->findChild<QtAcrylicWindowTracker *>(QString{}, Qt::FindDirectChildrenOnly);
+    if (!tracker) {
+        // Owned by the window, it goes away together with it.
+        tracker = new QtAcrylicWindowTracker(window);
+    }
+    return tracker;
+}
+
+QWindow *QtAcrylicWindowTracker::window() const
+{
+    return m_window;
+}
+
+void QtAcrylicWindowTracker::registerSurface(QObject *surface, const OffsetCallback &offsetCallback, const UpdateCallback &updateCallback,
+                                             const BackdropCallback &backdropCallback)
+{
+    Q_ASSERT(surface);
+    Q_ASSERT(offsetCallback);
+    Q_ASSERT(updateCallback);
+    if (!surface || !offsetCallback || !updateCallback) {
+        return;
+    }
+    if (!m_surfaces.contains(surface)) {
+        connect(surface, &QObject::destroyed, this, [this](QObject *object){
+            m_surfaces.remove(object);
+            invalidateOcclusion();
+        });
+    }
+    Surface &data = m_surfaces[surface];
+    data.offsetCallback = offsetCallback;
+    data.updateCallback = updateCallback;
+    data.backdropCallback = backdropCallback;
+    data.offsetValid = false;
+    invalidateOcclusion();
+}
+
+void QtAcrylicWindowTracker::unregisterSurface(QObject *surface)
+{
+    Q_ASSERT(surface);
+    if (!surface) {
+        return;
+    }
+    if (m_surfaces.remove(surface) > 0) {
+        disconnect(surface, &QObject::destroyed, this, nullptr);
+        invalidateOcclusion();
+    }
+}
+
+void QtAcrylicWindowTracker::invalidateOffset(QObject *surface)
+{
+    Q_ASSERT(surface);
+    if (!surface) {
+        return;
+    }
+    const auto it = m_surfaces.find(surface);
+    if (it != m_surfaces.end()) {
+        it->offsetValid = false;
+        invalidateOcclusion();
+    }
+}
+
+void QtAcrylicWindowTracker::invalidateOffsets()
+{
+    for (auto it = m_surfaces.begin(); it != m_surfaces.end(); ++it) {
+        it->offsetValid = false;
+    }
+    invalidateOcclusion();
+}
+
+QPoint QtAcrylicWindowTracker::globalPosition(QObject *surface)
+{
+    Q_ASSERT(surface);
+    if (!surface) {
+        return {};
+    }
+    const auto it = m_surfaces.find(surface);
+    if (it == m_surfaces.end()) {
+        return m_windowPosition;
+    }
+    return (m_windowPosition + surfaceOffset(*it));
+}
+
+void QtAcrylicWindowTracker::scheduleUpdate(QObject *surface)
+{
+    Q_ASSERT(surface);
+    if (!surface) {
+        return;
+    }
+    const auto it = m_surfaces.constFind(surface);
+    if (it != m_surfaces.constEnd()) {
+        QtAcrylicRepaintScheduler::schedule(m_window, surface, it->updateCallback);
+    }
+}
+
+void QtAcrylicWindowTracker::scheduleUpdates()
+{
+    for (auto it = m_surfaces.constBegin(); it != m_surfaces.constEnd(); ++it) {
+        QtAcrylicRepaintScheduler::schedule(m_window, it.key(), it->updateCallback);
+    }
+}
+
+void QtAcrylicWindowTracker::setOpaqueRegion(QObject *surface, const QRegion &region)
+{
+    Q_ASSERT(surface);
+    if (!surface) {
+        return;
+    }
+    const auto it = m_surfaces.find(surface);
+    if ((it == m_surfaces.end()) || (it->opaqueRegion == region)) {
+        return;
+    }
+    const bool uncovered = !(it->opaqueRegion - region).isEmpty();
+    it->opaqueRegion = region;
+    invalidateOcclusion();
+    if (!uncovered) {
+        return;
+    }
+    for (auto other = m_surfaces.constBegin(); other != m_surfaces.constEnd(); ++other) {
+        if (other.key() != surface) {
+            QtAcrylicRepaintScheduler::schedule(m_window, other.key(), other->updateCallback);
+        }
+    }
+}
+
+QRegion QtAcrylicWindowTracker::occludedRegion(QObject *surface, const OcclusionCallback &occlusionCallback,
+                                               const StackingCallback &stackingCallback)
+{
+    Q_ASSERT(surface);
+    Q_ASSERT(occlusionCallback);
+    Q_ASSERT(stackingCallback);
+    if (!surface || !occlusionCallback || !stackingCallback) {
+        return {};
+    }
+    const auto it = m_surfaces.constFind(surface);
+    if (it == m_surfaces.constEnd()) {
+        return {};
+    }
+    if (!m_occlusionValid) {
+        updateOcclusion(occlusionCallback, stackingCallback);
+    }
+    return it->occludedRegion;
+}
+
+QPoint QtAcrylicWindowTracker::surfaceOffset(Surface &data)
+{
+    if (!data.offsetValid) {
+        data.offset = data.offsetCallback();
+        data.offsetValid = true;
+    }
+    return data.offset;
+}
+
+void QtAcrylicWindowTracker::invalidateOcclusion()
+{
+    m_occlusionValid = false;
+}
+
+void QtAcrylicWindowTracker::updateOcclusion(const OcclusionCallback &occlusionCallback, const StackingCallback &stackingCallback)
+{
+    Q_ASSERT(occlusionCallback);
+    Q_ASSERT(stackingCallback);
+    QVector<QObject *> stacking = {};
+    stacking.reserve(m_surfaces.size());
+    for (auto it = m_surfaces.constBegin(); it != m_surfaces.constEnd(); ++it) {
+        stacking.append(it.key());
+    }
+    stackingCallback(stacking);
+    // Walk down from the top surface, each one is hidden by what has been covered
+    // so far, so every surface is only visited once.
+    QRegion covered = {};
+    std::for_each(stacking.crbegin(), stacking.crend(), [this, &covered, &occlusionCallback](QObject *object){
+        const auto it = m_surfaces.find(object);
+        if (it == m_surfaces.end()) {
+            return;
+        }
+        const QPoint offset = surfaceOffset(*it);
+        it->occludedRegion = covered.translated(-offset);
+        if (!it->opaqueRegion.isEmpty()) {
+            covered += occlusionCallback(object, it->opaqueRegion).translated(offset);
+        }
+    });
+    m_occlusionValid = true;
+    // Anything may have been restacked, shown or hidden before the next update, the
+    // surfaces are painted synchronously so this only runs once the update is done.
+    QMetaObject::invokeMethod(this, &QtAcrylicWindowTracker::invalidateOcclusion, Qt::QueuedConnection);
+}
+
+bool QtAcrylicWindowTracker::eventFilter(QObject *object, QEvent *event)
+{
+    if (object == m_window) {
+        switch (event->type()) {
+        case QEvent::Move: {
+            updateWindowPosition();
+            // Only the wallpaper blur depends on where the window is on the screen.
+            // Each surface may have its own configuration, so each one is asked.
+            for (auto it = m_surfaces.constBegin(); it != m_surfaces.constEnd(); ++it) {
+                if (!it->backdropCallback || it->backdropCallback()) {
+                    QtAcrylicRepaintScheduler::schedule(m_window, it.key(), it->updateCallback);
+                }
+            }
+        } break;
+        case QEvent::Resize:
+            // The layout of the window is going to change as well.
+            updateWindowPosition();
+            invalidateOffsets();
+            break;
+        case QEvent::PlatformSurface: {
+            // Keep the native handle index up to date, the handle changes whenever
+            // the native window is recreated.
+            const auto surfaceEvent = static_cast<QPlatformSurfaceEvent *>(event);
+            if (surfaceEvent->surfaceEventType() == QPlatformSurfaceEvent::SurfaceCreated) {
+                Utilities::registerWindow(m_window);
+            } else {
+                Utilities::unregisterWindow(m_window);
+            }
+        } break;
+        default:
+            break;
+        }
+    }
+    return QObject::eventFilter(object, event);
+}
+
+void QtAcrylicWindowTracker::updateWindowPosition()
+{
+    m_windowPosition = m_window->mapToGlobal(QPoint{0, 0});
+}
@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtacrylichelper_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpoint.h>
+#include <QtCore/qvector.h>
+#include <QtGui/qregion.h>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QWindow)
+QT_END_NAMESPACE
+
+// One instance per top level window, shared by all the acrylic surfaces inside it.
+// It watches the window position once, caches where each surface is on the screen
+// and forwards the invalidations to the surfaces when the window moves. It also
+// knows which parts of the window each surface covers with opaque pixels, so that
+// overlapping surfaces composite the backdrop only once per pixel.
+class QTACRYLICHELPER_API QtAcrylicWindowTracker : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QtAcrylicWindowTracker)
+
+public:
+    using OffsetCallback = std::function<QPoint()>;
+    using UpdateCallback = std::function<void()>;
+    using BackdropCallback = std::function<bool()>;
+    using OcclusionCallback = std::function<QRegion(QObject *, const QRegion &)>;
+    using StackingCallback = std::function<void(QVector<QObject *> &)>;
+
+    explicit QtAcrylicWindowTracker(QWindow *window);
+    ~QtAcrylicWindowTracker() override;
+
+    static QtAcrylicWindowTracker *get(QWindow *window);
+
+    QWindow *window() const;
+
+    // "offsetCallback" returns the position of the surface inside the window, it's
+    // only called when the cached value has been invalidated. "updateCallback" is
+    // called (at most once per frame) when the surface needs to be repainted.
+    // "backdropCallback" tells whether what the surface paints depends on where it
+    // is on the screen (the wallpaper blur mode of its own configuration), when it
+    // isn't given the surface is repainted on every window move.
+    void registerSurface(QObject *surface, const OffsetCallback &offsetCallback, const UpdateCallback &updateCallback,
+                         const BackdropCallback &backdropCallback = nullptr);
+    void unregisterSurface(QObject *surface);
+
+    // The surface (or one of its parents) moved inside the window.
+    void invalidateOffset(QObject *surface);
+    void invalidateOffsets();
+
+    QPoint globalPosition(QObject *surface);
+
+    void scheduleUpdate(QObject *surface);
+    void scheduleUpdates();
+
+    // The part of the surface, in its own coordinates, that it covers with opaque
+    // pixels. When it shrinks, the other surfaces are repainted since they may have
+    // skipped what is now uncovered.
+    void setOpaqueRegion(QObject *surface, const QRegion &region);
+    // The part of "surface", in its own coordinates, hidden by the surfaces above it.
+    // It's computed for all the surfaces at once and kept until the window update
+    // in progress is done, the callbacks are only called when it's out of date:
+    // "occlusionCallback" clips the opaque region of a surface to where it's visible
+    // and "stackingCallback" sorts the surfaces from the bottom to the top one.
+    QRegion occludedRegion(QObject *surface, const OcclusionCallback &occlusionCallback,
+                           const StackingCallback &stackingCallback);
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    struct Surface
+    {
+        OffsetCallback offsetCallback = nullptr;
+        UpdateCallback updateCallback = nullptr;
+        BackdropCallback backdropCallback = nullptr;
+        QPoint offset = {};
+        bool offsetValid = false;
+        QRegion opaqueRegion = {};
+        QRegion occludedRegion = {};
+    };
+
+    QPoint surfaceOffset(Surface &data);
+    void invalidateOcclusion();
+    void updateOcclusion(const OcclusionCallback &occlusionCallback, const StackingCallback &stackingCallback);
+    void updateWindowPosition();
+
+private:
+    QWindow *m_window = nullptr;
+    QPoint m_windowPosition = {};
+    QHash<QObject *, Surface> m_surfaces = {};
+    bool m_occlusionValid = false;
+};
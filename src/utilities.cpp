@@ -23,307 +23,480 @@
  */
 
 #include "utilities.h"
+#include "qtacrylicconfig.h"
+#include "qtacrylictrace.h"
+#include "kernels.h"
 #include <QtGui/private/qguiapplication_p.h>
 #include <QtGui/qpainter.h>
-#include <QtGui/private/qmemrotate_p.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qsemaphore.h>
+#include <atomic>
+#include <cmath>
+#include <limits>
 
-/*
- * Copied from https://code.qt.io/cgit/qt/qtbase.git/tree/src/widgets/effects/qpixmapfilter.cpp
- * With minor modifications, most of them are format changes.
- * They are exported functions of Qt, we can make use of them directly, but they are in the QtWidgets
- * module, I don't want our library have such a dependency.
- */
+static inline bool toPixelFormat(const QImage::Format format, Kernels::PixelFormat *result)
+{
+    Q_ASSERT(result);
+    if (!result) {
+        return false;
+    }
+    switch (format) {
+    case QImage::Format_Indexed8:
+    case QImage::Format_Grayscale8:
+        *result = Kernels::PixelFormat::Gray8;
+        return true;
+    case QImage::Format_RGB32:
+        *result = Kernels::PixelFormat::RGB32;
+        return true;
+    case QImage::Format_ARGB32_Premultiplied:
+        *result = Kernels::PixelFormat::ARGB32Premultiplied;
+        return true;
+    case QImage::Format_ARGB8565_Premultiplied:
+        *result = Kernels::PixelFormat::ARGB8565Premultiplied;
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
 
-#ifndef AVG
-#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
-#endif
+// Detaches the image, the kernel writes to it.
+static inline Kernels::ImageView toImageView(QImage &image, const Kernels::PixelFormat format)
+{
+    return {image.bits(), image.width(), image.height(), image.bytesPerLine(), format};
+}
 
-#ifndef AVG16
-#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
-#endif
+static inline Kernels::ConstImageView toConstImageView(const QImage &image, const Kernels::PixelFormat format)
+{
+    return {image.constBits(), image.width(), image.height(), image.bytesPerLine(), format};
+}
 
-template<const int shift>
-static inline int qt_static_shift(const int value)
+// Reuses the buffer of "image" if it has the right size and format and nothing
+// else shares it, so scratch images only allocate when the input changes.
+static inline void qt_prepareBuffer(QImage &image, const QSize &size, const QImage::Format format)
 {
-    if (shift == 0) {
-        return value;
-    } else if (shift > 0) {
-        return value << (uint(shift) & 0x1f);
-    } else {
-        return value >> (uint(-shift) & 0x1f);
+    if ((image.size() != size) || (image.format() != format) || !image.isDetached()) {
+        image = QImage(size, format);
     }
 }
 
-template<const int aprec, const int zprec>
-static inline void qt_blurinner(uchar *bptr, int &zR, int &zG, int &zB, int &zA, const int alpha)
-{
-    QRgb *pixel = reinterpret_cast<QRgb *>(bptr);
-#define Z_MASK (0xff << zprec)
-    const int A_zprec = qt_static_shift<zprec - 24>(*pixel) & Z_MASK;
-    const int R_zprec = qt_static_shift<zprec - 16>(*pixel) & Z_MASK;
-    const int G_zprec = qt_static_shift<zprec - 8>(*pixel)  & Z_MASK;
-    const int B_zprec = qt_static_shift<zprec>(*pixel)      & Z_MASK;
-#undef Z_MASK
-    const int zR_zprec = zR >> aprec;
-    const int zG_zprec = zG >> aprec;
-    const int zB_zprec = zB >> aprec;
-    const int zA_zprec = zA >> aprec;
-    zR += alpha * (R_zprec - zR_zprec);
-    zG += alpha * (G_zprec - zG_zprec);
-    zB += alpha * (B_zprec - zB_zprec);
-    zA += alpha * (A_zprec - zA_zprec);
-#define ZA_MASK (0xff << (zprec + aprec))
-    *pixel =
-        qt_static_shift<24 - zprec - aprec>(zA & ZA_MASK)
-        | qt_static_shift<16 - zprec - aprec>(zR & ZA_MASK)
-        | qt_static_shift<8 - zprec - aprec>(zG & ZA_MASK)
-        | qt_static_shift<-zprec - aprec>(zB & ZA_MASK);
-#undef ZA_MASK
+static inline void expblur(QImage &img, const qreal radius, const bool improvedQuality, const bool alphaOnly,
+                           const int transposed, QImage *scratch)
+{
+    Kernels::PixelFormat format = {};
+    const bool supported = (toPixelFormat(img.format(), &format) && (format != Kernels::PixelFormat::ARGB8565Premultiplied));
+    Q_ASSERT(supported);
+    if (!supported || img.isNull()) {
+        return;
+    }
+    // The columns are blurred as the rows of the transposed image.
+    QImage localTemp = {};
+    QImage &temp = (scratch ? *scratch : localTemp);
+    qt_prepareBuffer(temp, QSize{img.height(), img.width()}, img.format());
+    temp.setDevicePixelRatio(img.devicePixelRatio());
+    Kernels::expBlur(toImageView(img, format), toImageView(temp, format), radius, improvedQuality, alphaOnly, transposed);
+    if (transposed != 0) {
+        // The previous buffer of the image becomes the scratch of the next call.
+        img.swap(temp);
+    }
 }
 
-static const int alphaIndex = ((QSysInfo::ByteOrder == QSysInfo::BigEndian) ? 0 : 3);
-
-template<const int aprec, const int zprec>
-static inline void qt_blurinner_alphaOnly(uchar *bptr, int &z, const int alpha)
+static inline void qt_halfScaled(const QImage &source, QImage &dest)
 {
-    const int A_zprec = int(*(bptr)) << zprec;
-    const int z_zprec = z >> aprec;
-    z += alpha * (A_zprec - z_zprec);
-    *(bptr) = z >> (zprec + aprec);
+    if (source.width() < 2 || source.height() < 2) {
+        dest = {};
+        return;
+    }
+    QImage srcImage = source;
+    Kernels::PixelFormat format = {};
+    if (!toPixelFormat(source.format(), &format)) {
+        srcImage = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        format = Kernels::PixelFormat::ARGB32Premultiplied;
+    }
+    qt_prepareBuffer(dest, source.size() / 2, srcImage.format());
+    dest.setDevicePixelRatio(source.devicePixelRatio());
+    Kernels::halfScale(toConstImageView(srcImage, format), toImageView(dest, format));
 }
 
-template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void qt_blurrow(QImage &im, const int line, const int alpha)
+void _qam::Utilities::blurImage(QPainter *painter, QImage &blurImage, const qreal radius, const bool quality, const bool alphaOnly, const int transposed, BlurScratch *scratch)
 {
-    uchar *bptr = im.scanLine(line);
-    int zR = 0, zG = 0, zB = 0, zA = 0;
-    if (alphaOnly && (im.format() != QImage::Format_Indexed8)) {
-        bptr += alphaIndex;
+    if ((blurImage.format() != QImage::Format_ARGB32_Premultiplied) && (blurImage.format() != QImage::Format_RGB32)) {
+        blurImage = blurImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
     }
-    const int stride = im.depth() >> 3;
-    const int im_width = im.width();
-    for (int index = 0; index < im_width; ++index) {
-        if (alphaOnly) {
-            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+    qreal _radius = radius;
+    qreal scale = 1;
+    QImage *target = &blurImage;
+    if ((_radius >= 4) && (blurImage.width() >= 2) && (blurImage.height() >= 2)) {
+        const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::HalfScale, nullptr, blurImage.size());
+        if (scratch) {
+            qt_halfScaled(blurImage, scratch->halfScaled);
+            target = &scratch->halfScaled;
         } else {
-            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+            QImage halfScaled = {};
+            qt_halfScaled(blurImage, halfScaled);
+            blurImage.swap(halfScaled);
         }
-        bptr += stride;
+        scale = 2;
+        _radius *= 0.5;
     }
-    bptr -= stride;
-    for (int index = im_width - 2; index >= 0; --index) {
-        bptr -= stride;
-        if (alphaOnly) {
-            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
-        } else {
-            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
-        }
+    {
+        const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::Blur, nullptr, target->size());
+        QImage *transposedScratch = (scratch ? &scratch->transposed : nullptr);
+        expblur(*target, _radius, quality, alphaOnly, transposed, transposedScratch);
+    }
+    if (painter) {
+        const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::DrawBlur, nullptr, target->size());
+        painter->scale(scale, scale);
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawImage(QRect{QPoint{0, 0}, target->size() / target->devicePixelRatio()}, *target);
     }
 }
 
-/*
- *  expblur(QImage &img, const qreal radius)
- *
- *  Based on exponential blur algorithm by Jani Huhtanen
- *
- *  In-place blur of image 'img' with kernel
- *  of approximate radius 'radius'.
- *
- *  Blurs with two sided exponential impulse
- *  response.
- *
- *  aprec = precision of alpha parameter
- *  in fixed-point format 0.aprec
- *
- *  zprec = precision of state parameters
- *  zR,zG,zB and zA in fp format 8.zprec
- */
-template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void expblur(QImage &img, const qreal radius, const bool improvedQuality = false, const int transposed = 0)
+void _qam::Utilities::blurImage(QImage &blurImage, const qreal radius, const bool quality, const int transposed, BlurScratch *scratch)
 {
-    qreal _radius = radius;
-    // halve the radius if we're using two passes
-    if (improvedQuality) {
-        _radius *= 0.5;
+    const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::Blur, nullptr, blurImage.size());
+    QImage *transposedScratch = (scratch ? &scratch->transposed : nullptr);
+    // 8 bit images are blurred as alpha masks.
+    expblur(blurImage, radius, quality, false, transposed, transposedScratch);
+}
+
+// Shared by the calling thread and the threads of the pool: a single instance is
+// started once per worker thread, each run takes the next worker index and the
+// images are handed out one at a time until none is left.
+class QtAcrylicBlurTask : public QRunnable
+{
+public:
+    explicit QtAcrylicBlurTask(QImage *images, _qam::Utilities::BlurScratch *scratch, const int count, const qreal radius, const bool quality)
+        : m_images(images), m_scratch(scratch), m_count(count), m_radius(radius), m_quality(quality)
+    {
+        setAutoDelete(false);
     }
-    Q_ASSERT((img.format() == QImage::Format_ARGB32_Premultiplied)
-             || (img.format() == QImage::Format_RGB32)
-             || (img.format() == QImage::Format_Indexed8)
-             || (img.format() == QImage::Format_Grayscale8));
-    // choose the alpha such that pixels at radius distance from a fully
-    // saturated pixel will have an alpha component of no greater than
-    // the cutOffIntensity
-    const qreal cutOffIntensity = 2;
-    const int alpha = _radius <= qreal(1e-5)
-                    ? ((1 << aprec)-1)
-                    : qRound((1<<aprec)*(1 - qPow(cutOffIntensity * (1 / qreal(255)), 1 / _radius)));
-    int img_height = img.height();
-    for (int row = 0; row < img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(img, row, alpha);
-        }
+
+    ~QtAcrylicBlurTask() override = default;
+
+    void run() override
+    {
+        work(m_nextWorker++);
+        m_done.release();
     }
-    // TODO: QImage(int width, int height, QImage::Format format)
-    // Why the argument order is inverted here? The application will crash if change it back.
-    QImage temp(img.height(), img.width(), img.format());
-    temp.setDevicePixelRatio(img.devicePixelRatio());
-    if (transposed >= 0) {
-        if (img.depth() == 8) {
-            qt_memrotate270(reinterpret_cast<const quint8*>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint8*>(temp.bits()),
-                            temp.bytesPerLine());
-        } else {
-            qt_memrotate270(reinterpret_cast<const quint32*>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint32*>(temp.bits()),
-                            temp.bytesPerLine());
-        }
-    } else {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8*>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint8*>(temp.bits()),
-                           temp.bytesPerLine());
-        } else {
-            qt_memrotate90(reinterpret_cast<const quint32*>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint32*>(temp.bits()),
-                           temp.bytesPerLine());
+
+    void work(const int worker)
+    {
+        for (int index = m_nextImage++; index < m_count; index = m_nextImage++) {
+            _qam::Utilities::blurImage(m_images[index], m_radius, m_quality, 0, &m_scratch[worker]);
         }
     }
-    img_height = temp.height();
-    for (int row = 0; row < img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(temp, row, alpha);
+
+    void waitForWorkers(const int count)
+    {
+        m_done.acquire(count);
+    }
+
+private:
+    QImage *m_images = nullptr;
+    _qam::Utilities::BlurScratch *m_scratch = nullptr;
+    int m_count = 0;
+    qreal m_radius = 0.0;
+    bool m_quality = false;
+    std::atomic_int m_nextImage = {0};
+    std::atomic_int m_nextWorker = {1}; // The calling thread is the worker 0.
+    QSemaphore m_done;
+};
+
+void _qam::Utilities::blurImages(QVector<QImage> &images, const qreal radius, const bool quality, const int threadCount, BlurWorkers *workers)
+{
+    const int count = images.size();
+    if (count <= 0) {
+        return;
+    }
+    const int workerCount = qBound(1, threadCount, count);
+    QVector<BlurScratch> localScratch = {};
+    QVector<BlurScratch> &workerScratch = (workers ? workers->scratch : localScratch);
+    if (workerScratch.size() < workerCount) {
+        workerScratch.resize(workerCount);
+    }
+    QThreadPool *pool = (workers ? &workers->pool : QThreadPool::globalInstance());
+    if (workers && (pool->maxThreadCount() < (workerCount - 1))) {
+        pool->setMaxThreadCount(workerCount - 1);
+    }
+    // Detach the vectors here, the workers only touch their own elements.
+    QtAcrylicBlurTask task(images.data(), workerScratch.data(), count, radius, quality);
+    // Only idle threads are used, the calling thread takes over whatever the busy
+    // ones would have done. Waiting for queued runs could deadlock when called
+    // from a thread of the same pool.
+    int started = 0;
+    for (int worker = 1; worker < workerCount; ++worker) {
+        if (!pool->tryStart(&task)) {
+            break;
         }
+        ++started;
+    }
+    task.work(0);
+    task.waitForWorkers(started);
+}
+
+void _qam::Utilities::variableBlurImage(QImage &image, const QImage &radiusMap, const qreal maxRadius)
+{
+    Q_ASSERT(!radiusMap.isNull());
+    if (image.isNull() || radiusMap.isNull() || (maxRadius <= 0)) {
+        return;
+    }
+    const QtAcrylicTraceScope trace(QtAcrylicTrace::Stage::Blur, nullptr, image.size());
+    if ((image.format() != QImage::Format_ARGB32_Premultiplied) && (image.format() != QImage::Format_RGB32)) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    QImage map = radiusMap.convertToFormat(QImage::Format_Grayscale8);
+    if (map.size() != image.size()) {
+        map = map.scaled(image.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    Kernels::PixelFormat format = {};
+    toPixelFormat(image.format(), &format);
+    Kernels::variableBlur(toImageView(image, format), toConstImageView(map, Kernels::PixelFormat::Gray8), maxRadius);
+}
+
+QImage _qam::Utilities::halfScaledImage(const QImage &source)
+{
+    QImage result = {};
+    qt_halfScaled(source, result);
+    return result;
+}
+
+QImage _qam::Utilities::composeDesktopWallpaper(const QImage &wallpaper, const QSize &size, const DesktopWallpaperAspectStyle aspectStyle, const QColor &backgroundColor)
+{
+    Q_ASSERT(!wallpaper.isNull());
+    Q_ASSERT(size.isValid());
+    if (wallpaper.isNull() || !size.isValid()) {
+        return {};
+    }
+    QImage buffer(size, QImage::Format_ARGB32_Premultiplied);
+    if (backgroundColor.isValid() &&
+            ((aspectStyle == DesktopWallpaperAspectStyle::Central) ||
+             (aspectStyle == DesktopWallpaperAspectStyle::KeepRatioFit))) {
+        buffer.fill(backgroundColor);
+    } else {
+        buffer.fill(Qt::transparent);
     }
-    if (transposed == 0) {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8*>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint8*>(img.bits()),
-                           img.bytesPerLine());
+    QImage image = wallpaper;
+    if (aspectStyle == DesktopWallpaperAspectStyle::IgnoreRatioFit ||
+            aspectStyle == DesktopWallpaperAspectStyle::KeepRatioFit ||
+            aspectStyle == DesktopWallpaperAspectStyle::KeepRatioByExpanding) {
+        Qt::AspectRatioMode mode;
+        if (aspectStyle == DesktopWallpaperAspectStyle::IgnoreRatioFit) {
+            mode = Qt::IgnoreAspectRatio;
+        } else if (aspectStyle == DesktopWallpaperAspectStyle::KeepRatioFit) {
+            mode = Qt::KeepAspectRatio;
         } else {
-            qt_memrotate90(reinterpret_cast<const quint32*>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint32*>(img.bits()),
-                           img.bytesPerLine());
+            mode = Qt::KeepAspectRatioByExpanding;
         }
+        QSize newSize = image.size();
+        newSize.scale(size, mode);
+        image = image.scaled(newSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    }
+    QPainter painter(&buffer);
+    if (aspectStyle == DesktopWallpaperAspectStyle::Tiled) {
+        painter.fillRect(QRect{{0, 0}, size}, image);
     } else {
-        img = temp;
+        const QRect rect = alignedRect(Qt::LeftToRight, Qt::AlignCenter, image.size(), {{0, 0}, size});
+        painter.drawImage(rect.topLeft(), image);
     }
+    return buffer;
 }
 
-static inline QImage qt_halfScaled(const QImage &source)
+///////////////////////////////////////////////////
+
+// Integer finalizer with good avalanche behavior, so neighbouring pixel indices
+// produce uncorrelated values. Cheap enough to run for every texel.
+static inline quint32 qam_hash32(quint32 value)
 {
-    if (source.width() < 2 || source.height() < 2) {
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+QImage _qam::Utilities::generateNoiseTexture(const QSize &size, const qreal intensity, const quint32 seed)
+{
+    Q_ASSERT(!size.isEmpty());
+    if (size.isEmpty()) {
         return {};
     }
-    QImage srcImage = source;
-    if (source.format() == QImage::Format_Indexed8 || source.format() == QImage::Format_Grayscale8) {
-        // assumes grayscale
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
-        const uchar *src = reinterpret_cast<const uchar*>(const_cast<const QImage &>(srcImage).bits());
-        qsizetype sx = srcImage.bytesPerLine();
-        qsizetype sx2 = sx << 1;
-        uchar *dst = reinterpret_cast<uchar*>(dest.bits());
-        qsizetype dx = dest.bytesPerLine();
-        int ww = dest.width();
-        int hh = dest.height();
-        for (int y = hh; y; --y, dst += dx, src += sx2) {
-            const uchar *p1 = src;
-            const uchar *p2 = src + sx;
-            uchar *q = dst;
-            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
-                *q = ((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2;
-            }
-        }
-        return dest;
-    } else if (source.format() == QImage::Format_ARGB8565_Premultiplied) {
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
-        const uchar *src = reinterpret_cast<const uchar*>(const_cast<const QImage &>(srcImage).bits());
-        qsizetype sx = srcImage.bytesPerLine();
-        qsizetype sx2 = sx << 1;
-        uchar *dst = reinterpret_cast<uchar*>(dest.bits());
-        qsizetype dx = dest.bytesPerLine();
-        int ww = dest.width();
-        int hh = dest.height();
-        for (int y = hh; y; --y, dst += dx, src += sx2) {
-            const uchar *p1 = src;
-            const uchar *p2 = src + sx;
-            uchar *q = dst;
-            for (int x = ww; x; --x, q += 3, p1 += 6, p2 += 6) {
-                // alpha
-                q[0] = AVG(AVG(p1[0], p1[3]), AVG(p2[0], p2[3]));
-                // rgb
-                const quint16 p16_1 = (p1[2] << 8) | p1[1];
-                const quint16 p16_2 = (p1[5] << 8) | p1[4];
-                const quint16 p16_3 = (p2[2] << 8) | p2[1];
-                const quint16 p16_4 = (p2[5] << 8) | p2[4];
-                const quint16 result = AVG16(AVG16(p16_1, p16_2), AVG16(p16_3, p16_4));
-                q[1] = result & 0xff;
-                q[2] = result >> 8;
-            }
+    // White noise is tileable by construction, so the texture can be repeated by
+    // a brush without visible seams, whatever size the caller asks for.
+    QImage texture(size, QImage::Format_ARGB32_Premultiplied);
+    const int alpha = qRound(qBound(qreal(0), intensity, qreal(1)) * qreal(255));
+    const quint32 seedHash = qam_hash32(seed ^ 0x9e3779b9U);
+    const int width = texture.width();
+    const int height = texture.height();
+    for (int y = 0; y < height; ++y) {
+        auto line = reinterpret_cast<QRgb *>(texture.scanLine(y));
+        const quint32 rowBase = quint32(y) * quint32(width);
+        for (int x = 0; x < width; ++x) {
+            const int gray = int(qam_hash32((rowBase + quint32(x)) ^ seedHash) >> 24);
+            const int value = ((gray * alpha) + 127) / 255;
+            line[x] = qRgba(value, value, value, alpha);
         }
-        return dest;
-    } else if ((source.format() != QImage::Format_ARGB32_Premultiplied) && (source.format() != QImage::Format_RGB32)) {
-        srcImage = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
     }
-    QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-    dest.setDevicePixelRatio(source.devicePixelRatio());
-    const quint32 *src = reinterpret_cast<const quint32*>(const_cast<const QImage &>(srcImage).bits());
-    qsizetype sx = srcImage.bytesPerLine() >> 2;
-    qsizetype sx2 = sx << 1;
-    quint32 *dst = reinterpret_cast<quint32*>(dest.bits());
-    qsizetype dx = dest.bytesPerLine() >> 2;
-    int ww = dest.width();
-    int hh = dest.height();
-    for (int y = hh; y; --y, dst += dx, src += sx2) {
-        const quint32 *p1 = src;
-        const quint32 *p2 = src + sx;
-        quint32 *q = dst;
-        for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
-            *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
-        }
+    return texture;
+}
+
+///////////////////////////////////////////////////
+
+/*
+ * The blend modes follow the definitions of the W3C Compositing and Blending
+ * specification (non-separable blend modes), which are the same ones used by
+ * the Fluent Design acrylic recipe. Everything is done with integers and the
+ * per-color work is moved into lookup tables, so the per-pixel cost stays close
+ * to a plain alpha blend.
+ */
+
+static inline int qam_luminance(const _qam::Utilities::FluentBlendTables &tables, const int r, const int g, const int b)
+{
+    return (tables.lumR[r] + tables.lumG[g] + tables.lumB[b] + 128) >> 8;
+}
+
+static inline void qam_clipColor(int &r, int &g, int &b, const int l)
+{
+    const int n = qMin(r, qMin(g, b));
+    const int x = qMax(r, qMax(g, b));
+    if (n < 0) {
+        const int div = qMax(1, l - n);
+        r = l + (((r - l) * l) / div);
+        g = l + (((g - l) * l) / div);
+        b = l + (((b - l) * l) / div);
+    }
+    if (x > 255) {
+        const int div = qMax(1, x - l);
+        r = l + (((r - l) * (255 - l)) / div);
+        g = l + (((g - l) * (255 - l)) / div);
+        b = l + (((b - l) * (255 - l)) / div);
     }
-    return dest;
 }
 
-void _qam::Utilities::blurImage(QPainter *painter, QImage &blurImage, const qreal radius, const bool quality, const bool alphaOnly, const int transposed)
+_qam::Utilities::FluentBlendTables _qam::Utilities::createFluentBlendTables(const QColor &tintColor, const qreal tintOpacity, const qreal luminosityOpacity)
 {
-    if ((blurImage.format() != QImage::Format_ARGB32_Premultiplied) && (blurImage.format() != QImage::Format_RGB32)) {
-        blurImage = blurImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    FluentBlendTables tables = {};
+    for (int i = 0; i != 256; ++i) {
+        tables.lumR[i] = quint16(qRound(qreal(i) * 0.30 * 256));
+        tables.lumG[i] = quint16(qRound(qreal(i) * 0.59 * 256));
+        tables.lumB[i] = quint16(qRound(qreal(i) * 0.11 * 256));
     }
-    qreal _radius = radius;
-    qreal scale = 1;
-    if ((_radius >= 4) && (blurImage.width() >= 2) && (blurImage.height() >= 2)) {
-        blurImage = qt_halfScaled(blurImage);
-        scale = 2;
-        _radius *= 0.5;
+    const int tintR = tintColor.red();
+    const int tintG = tintColor.green();
+    const int tintB = tintColor.blue();
+    const int opacity = qRound(qBound(qreal(0), tintOpacity * tintColor.alphaF(), qreal(1)) * 256);
+    tables.luminosity = qam_luminance(tables, tintR, tintG, tintB);
+    tables.luminosityOpacity = qRound(qBound(qreal(0), luminosityOpacity * tintColor.alphaF(), qreal(1)) * 256);
+    tables.inverseTintOpacity = 256 - opacity;
+    // Color blend: hue and saturation of the tint, luminance of the backdrop.
+    // The tint is constant, so the result only depends on the backdrop luminance.
+    for (int l = 0; l != 256; ++l) {
+        const int d = l - tables.luminosity;
+        int r = tintR + d;
+        int g = tintG + d;
+        int b = tintB + d;
+        qam_clipColor(r, g, b, l);
+        tables.colorR[l] = quint16(qBound(0, r, 255) * opacity);
+        tables.colorG[l] = quint16(qBound(0, g, 255) * opacity);
+        tables.colorB[l] = quint16(qBound(0, b, 255) * opacity);
     }
-    if (alphaOnly) {
-        expblur<12, 10, true>(blurImage, _radius, quality, transposed);
-    } else {
-        expblur<12, 10, false>(blurImage, _radius, quality, transposed);
+    return tables;
+}
+
+void _qam::Utilities::fluentBlend(const QImage &source, const QRect &sourceRect, QImage &destination, const FluentBlendTables &tables)
+{
+    Q_ASSERT(!source.isNull());
+    Q_ASSERT(destination.format() == QImage::Format_ARGB32_Premultiplied);
+    if (source.isNull() || (destination.format() != QImage::Format_ARGB32_Premultiplied)) {
+        return;
     }
-    if (painter) {
-        painter->scale(scale, scale);
-        painter->setRenderHint(QPainter::SmoothPixmapTransform);
-        painter->drawImage(QRect{QPoint{0, 0}, blurImage.size() / blurImage.devicePixelRatio()}, blurImage);
+    const QImage src = ((source.format() == QImage::Format_ARGB32_Premultiplied) || (source.format() == QImage::Format_RGB32))
+            ? source : source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QRect rect = sourceRect.intersected(src.rect());
+    const int width = qMin(rect.width(), destination.width());
+    const int height = qMin(rect.height(), destination.height());
+    for (int y = 0; y < height; ++y) {
+        const auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(rect.y() + y)) + rect.x();
+        auto dstLine = reinterpret_cast<QRgb *>(destination.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            // The blend modes are defined on straight colors. The blured wallpaper
+            // is opaque in practice, for which this is a no-op.
+            const QRgb pixel = qUnpremultiply(srcLine[x]);
+            const int a = qAlpha(pixel);
+            int r = qRed(pixel);
+            int g = qGreen(pixel);
+            int b = qBlue(pixel);
+            if (tables.luminosityOpacity != 0) {
+                // Luminosity blend: hue and saturation of the backdrop, luminance of the tint.
+                const int d = tables.luminosity - qam_luminance(tables, r, g, b);
+                int lr = r + d;
+                int lg = g + d;
+                int lb = b + d;
+                qam_clipColor(lr, lg, lb, tables.luminosity);
+                r += ((lr - r) * tables.luminosityOpacity) / 256;
+                g += ((lg - g) * tables.luminosityOpacity) / 256;
+                b += ((lb - b) * tables.luminosityOpacity) / 256;
+                r = qBound(0, r, 255);
+                g = qBound(0, g, 255);
+                b = qBound(0, b, 255);
+            }
+            const int l = qam_luminance(tables, r, g, b);
+            r = ((r * tables.inverseTintOpacity) + tables.colorR[l]) >> 8;
+            g = ((g * tables.inverseTintOpacity) + tables.colorG[l]) >> 8;
+            b = ((b * tables.inverseTintOpacity) + tables.colorB[l]) >> 8;
+            dstLine[x] = ((a == 255) ? qRgba(r, g, b, a) : qPremultiply(qRgba(r, g, b, a)));
+        }
     }
 }
 
-void _qam::Utilities::blurImage(QImage &blurImage, const qreal radius, const bool quality, const int transposed)
+_qam::Utilities::ImageDifference _qam::Utilities::compareImages(const QImage &image, const QImage &reference, const int tolerance)
 {
-    if ((blurImage.format() == QImage::Format_Indexed8) || (blurImage.format() == QImage::Format_Grayscale8)) {
-        expblur<12, 10, true>(blurImage, radius, quality, transposed);
-    } else {
-        expblur<12, 10, false>(blurImage, radius, quality, transposed);
+    ImageDifference result = {};
+    if (image.isNull() || reference.isNull() || (image.size() != reference.size())) {
+        return result;
+    }
+    result.comparable = true;
+    const QImage actual = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QImage expected = reference.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    quint64 errorSum = 0;
+    quint64 squaredErrorSum = 0;
+    for (int y = 0; y != actual.height(); ++y) {
+        const auto actualLine = reinterpret_cast<const QRgb *>(actual.constScanLine(y));
+        const auto expectedLine = reinterpret_cast<const QRgb *>(expected.constScanLine(y));
+        for (int x = 0; x != actual.width(); ++x) {
+            const QRgb a = actualLine[x];
+            const QRgb e = expectedLine[x];
+            if (a == e) {
+                continue;
+            }
+            const int errors[4] = {
+                qAbs(qRed(a) - qRed(e)),
+                qAbs(qGreen(a) - qGreen(e)),
+                qAbs(qBlue(a) - qBlue(e)),
+                qAbs(qAlpha(a) - qAlpha(e))
+            };
+            int pixelError = 0;
+            for (const int error : errors) {
+                pixelError = qMax(pixelError, error);
+                errorSum += error;
+                squaredErrorSum += error * error;
+            }
+            result.maxError = qMax(result.maxError, pixelError);
+            if (pixelError > tolerance) {
+                ++result.differentPixels;
+            }
+        }
     }
+    const qreal samples = qreal(actual.width()) * qreal(actual.height()) * 4.0;
+    result.meanError = qreal(errorSum) / samples;
+    const qreal meanSquareError = qreal(squaredErrorSum) / samples;
+    result.rootMeanSquareError = std::sqrt(meanSquareError);
+    result.peakSignalToNoiseRatio = ((squaredErrorSum == 0) ? std::numeric_limits<qreal>::infinity()
+                                                            : (10.0 * std::log10((255.0 * 255.0) / meanSquareError)));
+    return result;
 }
 
 ///////////////////////////////////////////////////
@@ -362,20 +535,85 @@ QRect _qam::Utilities::alignedRect(const Qt::LayoutDirection direction, const Qt
 
 ///////////////////////////////////////////////////
 
+struct QtAcrylicWindowRegistry {
+    QHash<WId, QPointer<QWindow>> windows = {};
+    QHash<const QWindow *, WId> winIds = {};
+};
+
+Q_GLOBAL_STATIC(QtAcrylicWindowRegistry, windowRegistry)
+
+void _qam::Utilities::registerWindow(QWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return;
+    }
+    // Never force the creation of the native window, it is registered again once
+    // it exists (or found on the next lookup).
+    if (!window->handle()) {
+        return;
+    }
+    const WId winId = window->winId();
+    QtAcrylicWindowRegistry *registry = windowRegistry();
+    const auto it = registry->winIds.constFind(window);
+    if (it != registry->winIds.constEnd()) {
+        if (it.value() == winId) {
+            return;
+        }
+        // The native window has been recreated.
+        registry->windows.remove(it.value());
+    } else {
+        QObject::connect(window, &QObject::destroyed, [window](){
+            if (windowRegistry.isDestroyed()) {
+                return;
+            }
+            unregisterWindow(window);
+            windowRegistry()->winIds.remove(window);
+        });
+    }
+    registry->winIds.insert(window, winId);
+    registry->windows.insert(winId, window);
+}
+
+void _qam::Utilities::unregisterWindow(const QWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return;
+    }
+    if (windowRegistry.isDestroyed()) {
+        return;
+    }
+    QtAcrylicWindowRegistry *registry = windowRegistry();
+    const auto it = registry->winIds.find(window);
+    if (it == registry->winIds.end()) {
+        return;
+    }
+    const auto windowIt = registry->windows.find(it.value());
+    if ((windowIt != registry->windows.end()) && (windowIt->isNull() || (windowIt->data() == window))) {
+        registry->windows.erase(windowIt);
+    }
+    // Keep the entry while the window is alive, it remembers that the destroyed
+    // signal is already connected.
+    it.value() = 0;
+}
+
 QWindow *_qam::Utilities::findWindow(const WId winId)
 {
     Q_ASSERT(winId);
     if (!winId) {
         return nullptr;
     }
-    const QWindowList windows = QGuiApplication::topLevelWindows();
-    for (auto &&window : qAsConst(windows)) {
-        if (window && window->handle()) {
-            if (window->winId() == winId) {
-                return window;
-            }
-        }
+    QtAcrylicWindowRegistry *registry = windowRegistry();
+    const auto it = registry->windows.constFind(winId);
+    if (it == registry->windows.constEnd()) {
+        return nullptr;
     }
+    QWindow *window = it->data();
+    if (window && window->handle() && (window->winId() == winId)) {
+        return window;
+    }
+    registry->windows.remove(winId);
     return nullptr;
 }
 
@@ -384,27 +622,32 @@ bool _qam::Utilities::shouldUseWallpaperBlur()
     return !shouldUseTraditionalBlur();
 }
 
+bool _qam::Utilities::shouldUseTraditionalBlur()
+{
+    return QtAcrylicConfig::current()->traditionalBlur;
+}
+
 bool _qam::Utilities::disableExtraProcessingForBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_disableExtraProcess);
+    return QtAcrylicConfig::current()->disableExtraProcessing;
 }
 
 bool _qam::Utilities::forceEnableTraditionalBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceEnableTraditionalBlur_flag);
+    return QtAcrylicConfig::current()->forceEnableTraditionalBlur;
 }
 
 bool _qam::Utilities::forceDisableTraditionalBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceDisableTraditionalBlur_flag);
+    return QtAcrylicConfig::current()->forceDisableTraditionalBlur;
 }
 
 bool _qam::Utilities::forceEnableWallpaperBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceEnableWallpaperBlur_flag);
+    return QtAcrylicConfig::current()->forceEnableWallpaperBlur;
 }
 
 bool _qam::Utilities::forceDisableWallpaperBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceDisableWallpaperBlur_flag);
+    return QtAcrylicConfig::current()->forceDisableWallpaperBlur;
 }
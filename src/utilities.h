@@ -27,6 +27,9 @@
 #include "qtacrylichelper_global.h"
 #include <QtGui/qcolor.h>
 #include <QtGui/qwindow.h>
+#include <QtGui/qimage.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qthreadpool.h>
 
 namespace _qam::Utilities {
 
@@ -40,6 +43,58 @@ enum class DesktopWallpaperAspectStyle
     Span
 };
 
+// Lookup tables for the Fluent acrylic recipe: a luminosity blend with the tint
+// followed by a color blend with the tint, see createFluentBlendTables().
+struct FluentBlendTables
+{
+    // Luminance contribution of each channel, in 8.8 fixed point.
+    quint16 lumR[256] = {};
+    quint16 lumG[256] = {};
+    quint16 lumB[256] = {};
+    // The tint color carrying the luminance of the index, already multiplied
+    // by the tint opacity, in 8.8 fixed point.
+    quint16 colorR[256] = {};
+    quint16 colorG[256] = {};
+    quint16 colorB[256] = {};
+    int luminosity = 0; // Luminance of the luminosity layer, [0, 255].
+    int luminosityOpacity = 0; // [0, 256]
+    int inverseTintOpacity = 256; // [0, 256]
+};
+
+// Memory reused by blurImage() across calls, so blurring many images of the same
+// size and format doesn't touch the heap once the buffers have grown. Not thread
+// safe, use one per thread.
+struct BlurScratch
+{
+    QImage transposed = {};
+    QImage halfScaled = {};
+};
+
+// Threads and memory reused by blurImages() across calls: the threads of the pool
+// are started by the first call and wait for the next one, each of them has its own
+// scratch. Keep one around to blur batches in a loop.
+struct BlurWorkers
+{
+    BlurWorkers()
+    {
+        pool.setExpiryTimeout(-1);
+    }
+
+    QThreadPool pool;
+    QVector<BlurScratch> scratch = {};
+};
+
+// Error statistics of an image against a reference, see compareImages().
+struct ImageDifference
+{
+    bool comparable = false; // False if an image is null or the sizes differ.
+    int maxError = 0; // Largest absolute difference of any channel, [0, 255].
+    qreal meanError = 0.0; // Mean absolute difference over all channels.
+    qreal rootMeanSquareError = 0.0;
+    qreal peakSignalToNoiseRatio = 0.0; // In dB, infinite for identical images.
+    qint64 differentPixels = 0; // Pixels with a channel differing by more than the tolerance.
+};
+
 // Common
 QTACRYLICHELPER_API bool shouldUseWallpaperBlur();
 QTACRYLICHELPER_API bool shouldUseTraditionalBlur();
@@ -47,7 +102,14 @@ QTACRYLICHELPER_API bool setBlurEffectEnabled(const QWindow *window, const bool
 
 QTACRYLICHELPER_API bool isDarkThemeEnabled();
 
+// Native handle lookups go through a hash index. Only the windows that need the
+// native notifications are in it: the window tracker of each window with acrylic
+// surfaces keeps it up to date when the native window is created and destroyed,
+// and the windows get added when they get a native effect. A miss is just a hash
+// miss, not a walk over all the windows of the application.
 QTACRYLICHELPER_API QWindow *findWindow(const WId winId);
+QTACRYLICHELPER_API void registerWindow(QWindow *window);
+QTACRYLICHELPER_API void unregisterWindow(const QWindow *window);
 
 QTACRYLICHELPER_API QImage getDesktopWallpaperImage(const int screen = -1);
 QTACRYLICHELPER_API QColor getDesktopBackgroundColor(const int screen = -1);
@@ -55,8 +117,36 @@ QTACRYLICHELPER_API DesktopWallpaperAspectStyle getDesktopWallpaperAspectStyle(c
 
 QTACRYLICHELPER_API QRect alignedRect(const Qt::LayoutDirection direction, const Qt::Alignment alignment, const QSize &size, const QRect &rectangle);
 
-QTACRYLICHELPER_API void blurImage(QImage &blurImage, const qreal radius, const bool quality, const int transposed = 0);
-QTACRYLICHELPER_API void blurImage(QPainter *painter, QImage &blurImage, const qreal radius, const bool quality, const bool alphaOnly, const int transposed = 0);
+QTACRYLICHELPER_API void blurImage(QImage &blurImage, const qreal radius, const bool quality, const int transposed = 0, BlurScratch *scratch = nullptr);
+// For large radii the image is half scaled before blurring. Without a scratch, it
+// is replaced by the half scaled copy. With one, the copy goes into the scratch and
+// the image is left untouched.
+QTACRYLICHELPER_API void blurImage(QPainter *painter, QImage &blurImage, const qreal radius, const bool quality, const bool alphaOnly, const int transposed = 0, BlurScratch *scratch = nullptr);
+// Blurs every image in place, on up to "threadCount" threads (the calling thread
+// included). Without "workers", the global thread pool is used and the scratch
+// memory is allocated for the call only.
+QTACRYLICHELPER_API void blurImages(QVector<QImage> &images, const qreal radius, const bool quality, const int threadCount = 1, BlurWorkers *workers = nullptr);
+// Progressive blur: the radius of each pixel follows the gray level of "radiusMap",
+// from sharp (black) to "maxRadius" (white). The map is stretched to the size of the
+// image, a one pixel wide vertical gradient gives a radius per row. Costs about as
+// much as a single blurImage() call.
+QTACRYLICHELPER_API void variableBlurImage(QImage &image, const QImage &radiusMap, const qreal maxRadius);
+// Box filter downscale by two in each direction, the first stage of blurImage() for large radii.
+QTACRYLICHELPER_API QImage halfScaledImage(const QImage &source);
+
+// Lays out the wallpaper on a screen sized buffer the way the desktop does, this is
+// the input of the wallpaper blur. An invalid background color leaves the uncovered
+// area transparent.
+QTACRYLICHELPER_API QImage composeDesktopWallpaper(const QImage &wallpaper, const QSize &size, const DesktopWallpaperAspectStyle aspectStyle, const QColor &backgroundColor = {});
+
+QTACRYLICHELPER_API QImage generateNoiseTexture(const QSize &size, const qreal intensity = 1.0, const quint32 seed = 0);
+
+QTACRYLICHELPER_API FluentBlendTables createFluentBlendTables(const QColor &tintColor, const qreal tintOpacity, const qreal luminosityOpacity);
+QTACRYLICHELPER_API void fluentBlend(const QImage &source, const QRect &sourceRect, QImage &destination, const FluentBlendTables &tables);
+
+// Compares premultiplied ARGB values, so kernel rewrites can be checked against
+// reference images rendered by the previous implementation.
+QTACRYLICHELPER_API ImageDifference compareImages(const QImage &image, const QImage &reference, const int tolerance = 0);
 
 QTACRYLICHELPER_API bool disableExtraProcessingForBlur();
 QTACRYLICHELPER_API bool forceEnableTraditionalBlur();
@@ -69,6 +159,8 @@ QTACRYLICHELPER_API bool forceDisableWallpaperBlur();
 QTACRYLICHELPER_API bool isWin8OrGreater();
 QTACRYLICHELPER_API bool isWin10OrGreater();
 QTACRYLICHELPER_API bool isWin10OrGreater(const int subVer);
+// Whether the OS blur can be used at all, the user flags are not taken into account.
+QTACRYLICHELPER_API bool isTraditionalBlurSupported();
 
 QTACRYLICHELPER_API bool isOfficialMSWin10AcrylicBlurAvailable();
 
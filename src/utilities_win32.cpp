@@ -31,6 +31,7 @@
 #endif
 
 #include "utilities.h"
+#include "qtacrylicconfig.h"
 #include <QtCore/qsettings.h>
 #include <QtCore/qlibrary.h>
 #include <QtCore/qt_windows.h>
@@ -123,6 +124,8 @@ bool _qam::Utilities::setBlurEffectEnabled(const QWindow *window, const bool ena
     if (!hwnd) {
         return false;
     }
+    // The native event filter will look this window up for every system notification.
+    registerWindow(const_cast<QWindow *>(window));
     bool result = false;
     // We prefer DwmEnableBlurBehindWindow on Windows 7.
     if (isWin8OrGreater() && win32Data()->SetWindowCompositionAttributePFN) {
@@ -479,12 +482,12 @@ bool _qam::Utilities::isWin10OrGreater(const int subVer)
 
 static inline bool forceEnableOfficialMSWin10AcrylicBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceEnableOfficialMSWin10AcrylicBlur_flag);
+    return QtAcrylicConfig::current()->forceEnableOfficialMSWin10AcrylicBlur;
 }
 
 static inline bool forceDisableOfficialMSWin10AcrylicBlur()
 {
-    return qEnvironmentVariableIsSet(_qam::Global::_qam_forceDisableOfficialMSWin10AcrylicBlur_flag);
+    return QtAcrylicConfig::current()->forceDisableOfficialMSWin10AcrylicBlur;
 }
 
 static inline bool shouldUseOfficialMSWin10AcrylicBlur()
@@ -520,7 +523,7 @@ bool _qam::Utilities::isOfficialMSWin10AcrylicBlurAvailable()
     return shouldUseOfficialMSWin10AcrylicBlur();
 }
 
-static inline bool shouldUseOriginalDwmBlur()
+bool _qam::Utilities::isTraditionalBlurSupported()
 {
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 9, 0))
     return _qam::Utilities::isWin10OrGreater() || (QOperatingSystemVersion::current() >= QOperatingSystemVersion::OSXYosemite);
@@ -529,11 +532,3 @@ static inline bool shouldUseOriginalDwmBlur()
     return false;
 #endif
 }
-
-bool _qam::Utilities::shouldUseTraditionalBlur()
-{
-    const bool userAllowed = !(forceDisableTraditionalBlur() || forceEnableWallpaperBlur());
-    const bool osAllowed = shouldUseOriginalDwmBlur();
-    const bool result = (userAllowed && osAllowed);
-    return result;
-}
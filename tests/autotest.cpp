@@ -0,0 +1,334 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtTest/qtest.h>
+#include <QtGui/qpainter.h>
+#include <QtCore/qdir.h>
+#include "qtacryliceffecthelper.h"
+#include "qtacrylicconfig.h"
+#include "qtacrylicqualitygovernor.h"
+#include "qtacrylicsettings.h"
+#include "utilities.h"
+#include "testsupport.h"
+#ifdef QTACRYLIC_HAS_WIDGETS
+#include <QtWidgets/qapplication.h>
+#include "qtacrylicwidget.h"
+#endif
+#ifdef QTACRYLIC_HAS_QUICK
+#include <QtQuick/qquickwindow.h>
+#include "qtacrylicitem.h"
+#endif
+
+using namespace _qam;
+using namespace _qam::TestSupport;
+
+// Rendering regression tests. The renderings are compared with the reference
+// images in the "references" directory, set QTACRYLIC_UPDATE_REFERENCES to record
+// them again (after an intended change of the output only).
+
+// Largest channel difference a pixel may have without being counted as different,
+// the blur is integer arithmetic but the scaling done by QPainter may vary a little
+// between its code paths.
+static constexpr const int kPixelTolerance = 2;
+// Share of the pixels allowed to be over the tolerance in the surface renderings.
+static constexpr const qreal kMaxDifferentPixels = 0.001;
+
+static const QSize kScreenSize = {800, 600};
+static const QRect kSurfaceGeometry = {40, 30, 320, 200};
+
+static void useSyntheticWallpaper()
+{
+    QtAcrylicEffectHelper::setWallpaperOverride(syntheticWallpaper(QSize{1024, 640}),
+                                                Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding, kScreenSize);
+}
+
+static QImage paintSurface(QtAcrylicEffectHelper &helper, const QRect &rect)
+{
+    QImage image(rect.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    helper.paintBackground(&painter, rect, {}, 1.0);
+    return image;
+}
+
+// Reports the statistics in any case, so that a kernel rework can see how close
+// it gets even when it passes.
+static void compareWithReference(const QImage &image, const QString &name, const qreal maxDifferentPixels = 0)
+{
+    const QString directory = QString::fromUtf8(QTACRYLIC_REFERENCE_DIR);
+    const QString fileName = QDir(directory).filePath(name + QStringLiteral(".png"));
+    if (qEnvironmentVariableIsSet("QTACRYLIC_UPDATE_REFERENCES")) {
+        QVERIFY(QDir().mkpath(directory));
+        QVERIFY2(image.save(fileName), qPrintable(fileName));
+        return;
+    }
+    // A missing reference is a failure, a renaming or a lost file must not turn the
+    // test into a silent pass.
+    const QImage reference(fileName);
+    QVERIFY2(!reference.isNull(), qPrintable(QStringLiteral("%1 doesn't exist, record it with QTACRYLIC_UPDATE_REFERENCES set.").arg(fileName)));
+    const Utilities::ImageDifference difference = Utilities::compareImages(image, reference, kPixelTolerance);
+    QVERIFY2(difference.comparable, qPrintable(QStringLiteral("%1: the sizes differ.").arg(name)));
+    qInfo("%s: max %d, mean %.4f, RMS %.4f, PSNR %.2f dB, %lld pixels over the tolerance.", qPrintable(name),
+          difference.maxError, difference.meanError, difference.rootMeanSquareError,
+          difference.peakSignalToNoiseRatio, difference.differentPixels);
+    const qint64 allowed = qint64(maxDifferentPixels * image.width() * image.height());
+    QVERIFY(difference.differentPixels <= allowed);
+}
+
+class QtAcrylicTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void blurImage_data();
+    void blurImage();
+    void fluentBlendUnpremultiplies();
+    void fluentFallsBackWithoutWallpaper();
+    void opaqueOffPrimaryScreen();
+    void generations();
+#ifdef QTACRYLIC_HAS_WIDGETS
+    void widget_data();
+    void widget();
+#endif
+#ifdef QTACRYLIC_HAS_QUICK
+    void item();
+#endif
+};
+
+void QtAcrylicTest::initTestCase()
+{
+    // Nothing may depend on the machine: the blur of the platform, the desktop
+    // wallpaper and the speed of the machine (through the quality governor).
+    QtAcrylicConfig config = *QtAcrylicConfig::current();
+    config.traditionalBlur = false;
+    QtAcrylicConfig::setCurrent(config);
+    QtAcrylicQualityGovernor::instance()->setForcedTier(QtAcrylicQualityGovernor::Tier::Full);
+#ifdef QTACRYLIC_HAS_QUICK
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
+#else
+    QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+#endif
+#endif
+}
+
+void QtAcrylicTest::cleanupTestCase()
+{
+    QtAcrylicEffectHelper::clearWallpaperOverride();
+    QtAcrylicQualityGovernor::instance()->clearForcedTier();
+    QtAcrylicConfig::reloadFromEnvironment();
+}
+
+void QtAcrylicTest::init()
+{
+    useSyntheticWallpaper();
+}
+
+void QtAcrylicTest::blurImage_data()
+{
+    QTest::addColumn<qreal>("radius");
+    QTest::addColumn<int>("format");
+    const QList<QPair<const char *, QImage::Format>> formats = {
+        {"argb32pm", QImage::Format_ARGB32_Premultiplied},
+        {"rgb32", QImage::Format_RGB32}
+    };
+    for (auto &&format : qAsConst(formats)) {
+        // Small radii take the direct path, large ones go through the half scaled copy.
+        for (auto &&radius : {4.0, 16.0, 64.0}) {
+            QTest::addRow("%s-r%d", format.first, qRound(radius)) << radius << static_cast<int>(format.second);
+        }
+    }
+}
+
+void QtAcrylicTest::blurImage()
+{
+    QFETCH(qreal, radius);
+    QFETCH(int, format);
+    const QImage source = syntheticWallpaper({256, 160}, static_cast<QImage::Format>(format));
+    QImage result(source.size(), QImage::Format_ARGB32_Premultiplied);
+    result.fill(Qt::transparent);
+    {
+        QPainter painter(&result);
+        QImage image = source;
+        Utilities::blurImage(&painter, image, radius, false, false);
+    }
+    compareWithReference(result, QStringLiteral("blurImage-") + QString::fromLatin1(QTest::currentDataTag()));
+}
+
+void QtAcrylicTest::fluentBlendUnpremultiplies()
+{
+    // The blend modes work on straight colors, a translucent backdrop pixel must
+    // end up with the color of the opaque one, at its own alpha.
+    const Utilities::FluentBlendTables tables = Utilities::createFluentBlendTables(QColor(32, 96, 160), 0.6, 0.8);
+    QImage source(2, 1, QImage::Format_ARGB32_Premultiplied);
+    source.setPixel(0, 0, qRgba(200, 100, 50, 255));
+    source.setPixel(1, 0, qPremultiply(qRgba(200, 100, 50, 128)));
+    QImage destination(2, 1, QImage::Format_ARGB32_Premultiplied);
+    Utilities::fluentBlend(source, source.rect(), destination, tables);
+    const QRgb opaque = destination.pixel(0, 0);
+    const QRgb translucent = destination.pixel(1, 0);
+    const QRgb expected = qPremultiply(qRgba(qRed(opaque), qGreen(opaque), qBlue(opaque), 128));
+    QCOMPARE(qAlpha(translucent), 128);
+    // Premultiplying and unpremultiplying 128 loses a bit of precision.
+    QVERIFY(qAbs(qRed(translucent) - qRed(expected)) <= 1);
+    QVERIFY(qAbs(qGreen(translucent) - qGreen(expected)) <= 1);
+    QVERIFY(qAbs(qBlue(translucent) - qBlue(expected)) <= 1);
+}
+
+void QtAcrylicTest::fluentFallsBackWithoutWallpaper()
+{
+    // A fully transparent wallpaper, as when the desktop one can't be read: the
+    // Fluent recipe would have no pixels to blend the tint into.
+    QImage wallpaper(kScreenSize, QImage::Format_ARGB32_Premultiplied);
+    wallpaper.fill(Qt::transparent);
+    QtAcrylicEffectHelper::setWallpaperOverride(wallpaper, Utilities::DesktopWallpaperAspectStyle::KeepRatioByExpanding, kScreenSize);
+    QtAcrylicEffectHelper fluent;
+    fluent.setTintColor(QColor(32, 96, 160));
+    fluent.setMaterialMode(QtAcrylicEffectHelper::MaterialMode::Fluent);
+    QtAcrylicEffectHelper fallback;
+    fallback.setTintColor(QColor(32, 96, 160));
+    const QImage fluentImage = paintSurface(fluent, kSurfaceGeometry);
+    QVERIFY(!fluent.isOpaque());
+    // Same output as the default recipe, the tint is there.
+    QCOMPARE(fluentImage, paintSurface(fallback, kSurfaceGeometry));
+    QVERIFY(qAlpha(fluentImage.pixel(kSurfaceGeometry.width() / 2, kSurfaceGeometry.height() / 2)) > 0);
+}
+
+void QtAcrylicTest::opaqueOffPrimaryScreen()
+{
+    // Half of the surface is beyond the right edge of the primary screen, where
+    // there is no wallpaper, yet it reports itself as opaque.
+    QtAcrylicEffectHelper helper;
+    helper.setTintColor(QColor(32, 96, 160));
+    const QRect rect = {QPoint{kScreenSize.width() - (kSurfaceGeometry.width() / 2), 100}, kSurfaceGeometry.size()};
+    const QImage image = paintSurface(helper, rect);
+    QVERIFY(helper.isOpaque());
+    QCOMPARE(helper.getOpaqueRegion(rect.size()), QRegion(QRect{QPoint{0, 0}, rect.size()}));
+    for (int y = 0; y != image.height(); ++y) {
+        const auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x != image.width(); ++x) {
+            if (qAlpha(line[x]) != 255) {
+                QFAIL(qPrintable(QStringLiteral("Pixel (%1, %2) is not opaque.").arg(x).arg(y)));
+            }
+        }
+    }
+}
+
+void QtAcrylicTest::generations()
+{
+    // Each cache is rebuilt exactly when its inputs changed.
+    QtAcrylicEffectHelper helper;
+    helper.setTintColor(QColor(32, 96, 160));
+    paintSurface(helper, kSurfaceGeometry);
+    const qint64 wallpaperKey = helper.getBluredWallpaper().cacheKey();
+    QVERIFY(!helper.getBluredWallpaper().isNull());
+    // Neither repainting, nor the parameters of a surface, nor the theme.
+    paintSurface(helper, kSurfaceGeometry);
+    QCOMPARE(helper.getBluredWallpaper().cacheKey(), wallpaperKey);
+    helper.setTintColor(QColor(160, 96, 32));
+    helper.setNoiseOpacity(0.05);
+    paintSurface(helper, kSurfaceGeometry);
+    QCOMPARE(helper.getBluredWallpaper().cacheKey(), wallpaperKey);
+    QtAcrylicEffectHelper::notifyThemeChanged();
+    paintSurface(helper, kSurfaceGeometry);
+    QCOMPARE(helper.getBluredWallpaper().cacheKey(), wallpaperKey);
+    // The screen layout only matters through the size of the primary screen, which
+    // the override keeps the same.
+    QtAcrylicEffectHelper::notifyScreensChanged();
+    paintSurface(helper, kSurfaceGeometry);
+    QCOMPARE(helper.getBluredWallpaper().cacheKey(), wallpaperKey);
+    // A new wallpaper does.
+    QtAcrylicEffectHelper::notifyWallpaperChanged();
+    paintSurface(helper, kSurfaceGeometry);
+    QVERIFY(helper.getBluredWallpaper().cacheKey() != wallpaperKey);
+    // So does a new blur radius.
+    const qint64 newWallpaperKey = helper.getBluredWallpaper().cacheKey();
+    const qreal oldRadius = QtAcrylicSettings::instance()->blurRadius();
+    QtAcrylicSettings::instance()->setBlurRadius(oldRadius + 8);
+    paintSurface(helper, kSurfaceGeometry);
+    QtAcrylicSettings::instance()->setBlurRadius(oldRadius);
+    QVERIFY(helper.getBluredWallpaper().cacheKey() != newWallpaperKey);
+}
+
+#ifdef QTACRYLIC_HAS_WIDGETS
+void QtAcrylicTest::widget_data()
+{
+    QTest::addColumn<bool>("fluent");
+    QTest::addColumn<int>("cornerRadius");
+    QTest::addRow("default") << false << 0;
+    QTest::addRow("fluent") << true << 0;
+    QTest::addRow("rounded") << false << 16;
+}
+
+void QtAcrylicTest::widget()
+{
+    QFETCH(bool, fluent);
+    QFETCH(int, cornerRadius);
+    QtAcrylicWidget widget;
+    widget.setTintColor(QColor(32, 96, 160));
+    widget.setFluentMaterial(fluent);
+    widget.setCornerRadius(cornerRadius);
+    widget.setGeometry(kSurfaceGeometry);
+    widget.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&widget));
+    const QImage image = widget.grab().toImage();
+    compareWithReference(image, QStringLiteral("widget-") + QString::fromLatin1(QTest::currentDataTag()), kMaxDifferentPixels);
+}
+#endif
+
+#ifdef QTACRYLIC_HAS_QUICK
+void QtAcrylicTest::item()
+{
+    QQuickWindow window;
+    window.setGeometry(kSurfaceGeometry);
+    auto item = new QtAcrylicItem(window.contentItem());
+    item->setTintColor(QColor(32, 96, 160));
+    item->setSize(QSizeF(kSurfaceGeometry.size()));
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+    const QImage image = window.grabWindow();
+    compareWithReference(image, QStringLiteral("item"), kMaxDifferentPixels);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    // No desktop session needed, and the renderings don't depend on the one there is.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#ifdef QTACRYLIC_HAS_WIDGETS
+    QApplication application(argc, argv);
+#else
+    QGuiApplication application(argc, argv);
+#endif
+    QtAcrylicTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "autotest.moc"
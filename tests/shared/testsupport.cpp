@@ -0,0 +1,43 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "testsupport.h"
+#include <QtGui/qpainter.h>
+#include <QtGui/qbrush.h>
+#include "utilities.h"
+
+QImage _qam::TestSupport::syntheticWallpaper(const QSize &size, const QImage::Format format)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    QLinearGradient gradient(QPointF{0, 0}, QPointF(size.width(), size.height()));
+    gradient.setColorAt(0.0, QColor(0, 120, 215));
+    gradient.setColorAt(0.5, QColor(240, 180, 60));
+    gradient.setColorAt(1.0, QColor(30, 30, 30));
+    painter.fillRect(QRect{{0, 0}, size}, gradient);
+    painter.setOpacity(0.3);
+    painter.fillRect(QRect{{0, 0}, size}, QBrush(Utilities::generateNoiseTexture({64, 64})));
+    painter.end();
+    return ((format == image.format()) ? image : image.convertToFormat(format));
+}